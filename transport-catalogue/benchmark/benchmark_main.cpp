@@ -0,0 +1,315 @@
+#include "city_generator.h"
+
+#include "../instrumentation.h"
+#include "../json_reader.h"
+#include "../map_renderer.h"
+#include "../serialization.h"
+#include "../transport_router.h"
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+
+using namespace std::literals;
+using namespace transport_catalogue;
+
+namespace {
+
+struct BenchmarkOptions {
+    int requests_per_type = 1000;
+    int spatial_queries = 1000000;
+    int repetitions = 3;
+};
+
+template <typename Function>
+double MeasureMilliseconds(int repetitions, Function function) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; ++i) {
+        function();
+    }
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / std::max(repetitions, 1);
+}
+
+// The ostream-based printer json::Print used before it switched to a char
+// buffer, kept as the baseline for the serializer numbers.
+void PrintWithStream(const json::Node& node, std::ostream& out, int indent = 0) {
+    if (node.IsNull()) {
+        out << "null"sv;
+    } else if (node.IsBool()) {
+          out << (node.AsBool() ? "true"sv : "false"sv);
+      } else if (node.IsInt()) {
+            out << node.AsInt();
+        } else if (node.IsPureDouble()) {
+              out << node.AsDouble();
+          } else if (node.IsString()) {
+                out.put('"');
+                for (const char c : node.AsString()) {
+                    if (c == '\r') {
+                        out << "\\r"sv;
+                    } else if (c == '\n') {
+                          out << "\\n"sv;
+                      } else {
+                            if (c == '"' || c == '\\') {
+                                out.put('\\');
+                            }
+                            out.put(c);
+                        }
+                }
+                out.put('"');
+            } else {
+                  const bool is_array = node.IsArray();
+                  out.put(is_array ? '[' : '{');
+                  out.put('\n');
+                  bool first = true;
+                  auto print_item = [&](const std::string* key, const json::Node& value) {
+                      if (!first) {
+                          out << ",\n"sv;
+                      }
+                      first = false;
+                      for (int i = 0; i < indent + 4; ++i) {
+                          out.put(' ');
+                      }
+                      if (key) {
+                          PrintWithStream(json::Node(*key), out);
+                          out << ": "sv;
+                      }
+                      PrintWithStream(value, out, indent + 4);
+                  };
+                  if (is_array) {
+                      for (const json::Node& value : node.AsArray()) {
+                          print_item(nullptr, value);
+                      }
+                  } else {
+                        for (const auto& [key, value] : node.AsMap()) {
+                            print_item(&key, value);
+                        }
+                    }
+                  out.put('\n');
+                  for (int i = 0; i < indent; ++i) {
+                      out.put(' ');
+                  }
+                  out.put(is_array ? ']' : '}');
+              }
+}
+
+// The unit-sphere chord distance must agree with geo::ComputeDistance, whose
+// acos form loses about a decimetre to rounding on short spans. Returns the
+// largest deviation in metres over consecutive pairs of stops.
+double CheckStopPointDistances(const TransportCatalogue& catalogue) {
+    const std::deque<Stop>& stops = catalogue.GetAllStops();
+    const geo::UnitSphereArray& stop_points = catalogue.GetStopPoints();
+    double max_error = 0;
+    for (size_t i = 1; i < stops.size(); ++i) {
+        const double expected = geo::ComputeDistance(stops[i - 1].coord, stops[i].coord);
+        const double error = std::abs(stop_points.ComputeDistance(stops[i - 1].id, stops[i].id) - expected);
+        assert(error <= std::max(1., expected * 1e-6));
+        max_error = std::max(max_error, error);
+    }
+    return max_error;
+}
+
+json::Dict DescribeCity(const benchmark::CityParameters& parameters) {
+    json::Dict result;
+    result.emplace("name"s, parameters.name);
+    result.emplace("stop_count"s, parameters.stop_count);
+    result.emplace("bus_count"s, parameters.bus_count);
+    result.emplace("min_route_stops"s, parameters.min_route_stops);
+    result.emplace("max_route_stops"s, parameters.max_route_stops);
+    result.emplace("roundtrip_ratio"s, parameters.roundtrip_ratio);
+    result.emplace("distance_density"s, parameters.distance_density);
+    result.emplace("seed"s, static_cast<int>(parameters.seed));
+    return result;
+}
+
+// The base document with the stop requests shuffled, as an input that lists
+// stops in no particular order would come, and the given stop_order.
+std::string MakeShuffledBase(const json::Node& document, unsigned seed, std::string stop_order) {
+    json::Dict root = document.AsMap();
+    json::Array requests = root.at("base_requests"s).AsArray();
+    const auto buses_begin = std::partition(requests.begin(), requests.end(), [](const json::Node& request) {
+        return request.AsMap().at("type"s) == "Stop"s;
+    });
+    std::shuffle(requests.begin(), buses_begin, std::mt19937(seed));
+    json::Dict settings = root.at("serialization_settings"s).AsMap();
+    settings["stop_order"s] = std::move(stop_order);
+    root["serialization_settings"s] = std::move(settings);
+    root["base_requests"s] = std::move(requests);
+    std::ostringstream output;
+    json::Print(json::Document{std::move(root)}, output);
+    return output.str();
+}
+
+// Route answering and the all-pairs table over the same shuffled input, with
+// the stops numbered in input order and along the Hilbert curve.
+json::Dict MeasureStopOrders(const benchmark::CityGenerator& generator, const std::filesystem::path& base_file, const BenchmarkOptions& options, ThreadPool& pool) {
+    const benchmark::CityParameters& parameters = generator.GetParameters();
+    const json::Node document = generator.MakeBaseDocument(base_file);
+    json::Dict result;
+    for (const std::string& order : {"input"s, "hilbert"s}) {
+        TransportCatalogue catalogue;
+        TransportRouter router;
+        JSONReader reader(catalogue, router);
+        reader.SetThreadPool(pool);
+        std::istringstream input(MakeShuffledBase(document, parameters.seed + 3, order));
+        reader.MakeBase(input);
+        json::Dict measured;
+        measured.emplace("router_create_graph_ms"s, MeasureMilliseconds(1, [&catalogue, &router, &pool]() {
+            router.CreateGraph(catalogue, pool);
+        }));
+        for (const std::string_view type : {"Route"sv, "PointRoute"sv}) {
+            const json::Node requests(generator.MakeStatRequests(type, options.requests_per_type, parameters.seed + 1));
+            const double batch_ms = MeasureMilliseconds(1, [&reader, &requests]() {
+                reader.FillOutput(requests);
+            });
+            reader.TakeOutput();
+            measured.emplace(std::string{type} + "_ms"s, batch_ms / std::max(options.requests_per_type, 1));
+        }
+        result.emplace(order, std::move(measured));
+    }
+    return result;
+}
+
+json::Dict RunCity(const benchmark::CityParameters& parameters, const BenchmarkOptions& options) {
+    auto& registry = instrumentation::Registry::Instance();
+    registry.Reset();
+    ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u));
+    const benchmark::CityGenerator generator(parameters);
+    const std::filesystem::path base_file = std::filesystem::temp_directory_path() / ("transport_catalogue_benchmark_"s + parameters.name + ".db"s);
+    std::ostringstream base_stream;
+    json::Print(json::Document{generator.MakeBaseDocument(base_file)}, base_stream);
+    const std::string base_json = base_stream.str();
+
+    json::Dict results;
+    results.emplace("base_json_bytes"s, static_cast<double>(base_json.size()));
+    results.emplace("json_load_ms"s, MeasureMilliseconds(options.repetitions, [&base_json]() {
+        std::istringstream input(base_json);
+        json::Load(input);
+    }));
+    results.emplace("json_reader_make_base_ms"s, MeasureMilliseconds(options.repetitions, [&base_json, &pool]() {
+        TransportCatalogue catalogue;
+        TransportRouter router;
+        JSONReader reader(catalogue, router);
+        reader.SetThreadPool(pool);
+        std::istringstream input(base_json);
+        reader.MakeBase(input);
+    }));
+
+    TransportCatalogue catalogue;
+    TransportRouter router;
+    JSONReader reader(catalogue, router);
+    reader.SetThreadPool(pool);
+    std::istringstream input(base_json);
+    reader.MakeBase(input);
+    const renderer::RenderSettings render_settings = reader.GetParsedRenderSettings();
+    reader.SetRenderSettings(render_settings);
+    results.emplace("stop_point_max_error_m"s, CheckStopPointDistances(catalogue));
+
+    results.emplace("catalogue_fill_in_memory_ms"s, MeasureMilliseconds(options.repetitions, [&generator]() {
+        TransportCatalogue in_memory;
+        generator.FillCatalogue(in_memory);
+    }));
+    results.emplace("router_create_graph_ms"s, MeasureMilliseconds(1, [&catalogue, &router, &pool]() {
+        router.CreateGraph(catalogue, pool);
+    }));
+
+    // CreateGraph already ran, so each batch below measures the answering alone.
+    json::Dict per_request;
+    for (const std::string_view type : {"Bus"sv, "Stop"sv, "Route"sv, "PointRoute"sv, "NearbyStops"sv, "NearestStops"sv}) {
+        const json::Node requests(generator.MakeStatRequests(type, options.requests_per_type, parameters.seed + 1));
+        const double batch_ms = MeasureMilliseconds(1, [&reader, &requests]() {
+            reader.FillOutput(requests);
+        });
+        per_request.emplace(std::string{type}, batch_ms / std::max(options.requests_per_type, 1));
+    }
+    results.emplace("stat_request_ms"s, std::move(per_request));
+    results.emplace("stop_order"s, MeasureStopOrders(generator, base_file, options, pool));
+
+    // The answers gathered above plus one map make a typical response document.
+    reader.FillOutput(json::Array{json::Dict{{"id"s, 0}, {"type"s, "Map"s}}});
+    const json::Document answers(reader.TakeOutput());
+    std::ostringstream printed;
+    json::Print(answers, printed);
+    results.emplace("json_print_bytes"s, static_cast<double>(printed.str().size()));
+    results.emplace("json_print_ms"s, MeasureMilliseconds(options.repetitions, [&answers]() {
+        std::ostringstream output;
+        json::Print(answers, output);
+    }));
+    results.emplace("json_print_stream_ms"s, MeasureMilliseconds(options.repetitions, [&answers]() {
+        std::ostringstream output;
+        PrintWithStream(answers.GetRoot(), output);
+    }));
+
+    results.emplace("map_render_ms"s, MeasureMilliseconds(options.repetitions, [&catalogue, &render_settings]() {
+        renderer::MapRenderer map_renderer(render_settings);
+        std::ostringstream output;
+        map_renderer.RenderSvgMap(catalogue, output);
+    }));
+
+    serializator::Serializator serializator(catalogue, router);
+    serializator.SetSetting({base_file});
+    serializator.SetRendererSettings(render_settings);
+    serializator.SetRouterSettings(reader.GetRoutingSettings());
+    results.emplace("serialize_ms"s, MeasureMilliseconds(1, [&serializator]() {
+        serializator.Serialize();
+    }));
+    results.emplace("deserialize_ms"s, MeasureMilliseconds(options.repetitions, [&base_file]() {
+        TransportCatalogue loaded_catalogue;
+        TransportRouter loaded_router;
+        serializator::Serializator loader(loaded_catalogue, loaded_router);
+        loader.SetSetting({base_file});
+        loader.Deserialize();
+    }));
+    results.emplace("base_file_bytes"s, static_cast<double>(std::filesystem::file_size(base_file)));
+    std::filesystem::remove(base_file);
+
+    std::mt19937 point_generator(parameters.seed + 2);
+    std::uniform_real_distribution<double> shift(-0.5, 0.5);
+    const StopIndex& stop_index = catalogue.GetStopIndex();
+    const double span = parameters.grid_step * std::sqrt(parameters.stop_count);
+    std::vector<geo::Coordinates> points(std::min(options.spatial_queries, 100000));
+    for (auto& point : points) {
+        point = {parameters.center_lat + shift(point_generator) * span, parameters.center_lng + shift(point_generator) * span};
+    }
+    size_t found = 0;
+    results.emplace("nearest_5_stops_us"s, MeasureMilliseconds(options.spatial_queries, [&, query = size_t{0}]() mutable {
+        found += stop_index.FindNearest(points[query++ % points.size()], 5).size();
+    }) * 1000.);
+    results.emplace("stops_within_500m_us"s, MeasureMilliseconds(options.spatial_queries, [&, query = size_t{0}]() mutable {
+        found += stop_index.FindInRadius(points[query++ % points.size()], 500).size();
+    }) * 1000.);
+    results.emplace("spatial_results"s, static_cast<double>(found));
+
+    json::Dict city;
+    city.emplace("city"s, DescribeCity(parameters));
+    city.emplace("results"s, std::move(results));
+    city.emplace("instrumentation"s, registry.GetReport(parameters.name));
+    return city;
+}
+
+} // namespace
+
+// Usage: transport_catalogue_benchmark [stop_count...]
+// Prints a JSON document with one entry per generated city.
+int main(int argc, char* argv[]) {
+    std::vector<int> stop_counts{100, 500, 2000};
+    if (argc > 1) {
+        stop_counts.clear();
+        for (int i = 1; i < argc; ++i) {
+            stop_counts.push_back(std::stoi(argv[i]));
+        }
+    }
+    instrumentation::Registry::Instance().Enable();
+    BenchmarkOptions options;
+    json::Array cities;
+    for (int stop_count : stop_counts) {
+        benchmark::CityParameters parameters;
+        parameters.name = "city_"s + std::to_string(stop_count);
+        parameters.stop_count = stop_count;
+        parameters.bus_count = std::max(stop_count / 5, 1);
+        cities.emplace_back(RunCity(parameters, options));
+    }
+    json::Print(json::Document{json::Dict{{"benchmarks"s, std::move(cities)}}}, std::cout);
+    std::cout << std::endl;
+    return 0;
+}
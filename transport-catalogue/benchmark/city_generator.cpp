@@ -0,0 +1,224 @@
+#include "city_generator.h"
+
+using namespace std::literals;
+
+namespace transport_catalogue {
+namespace benchmark {
+
+CityGenerator::CityGenerator(CityParameters parameters) : parameters_(std::move(parameters)) {
+    Generate();
+}
+
+const CityParameters& CityGenerator::GetParameters() const {
+    return parameters_;
+}
+
+void CityGenerator::Generate() {
+    std::mt19937 generator(parameters_.seed);
+    std::uniform_real_distribution<double> unit(0., 1.);
+    const int stop_count = std::max(parameters_.stop_count, 2);
+    const int columns = static_cast<int>(std::ceil(std::sqrt(stop_count)));
+    const double jitter = parameters_.grid_step * 0.4;
+    for (int stop = 0; stop < stop_count; ++stop) {
+        const int row = stop / columns;
+        const int column = stop % columns;
+        stops_.push_back({parameters_.center_lat + (row - columns / 2) * parameters_.grid_step + (unit(generator) - 0.5) * jitter,
+                          parameters_.center_lng + (column - columns / 2) * parameters_.grid_step + (unit(generator) - 0.5) * jitter});
+    }
+    road_distances_.resize(stop_count);
+
+    auto add_span = [this, &generator, &unit](int from, int to) {
+        const auto curvature = parameters_.min_curvature + unit(generator) * (parameters_.max_curvature - parameters_.min_curvature);
+        const int distance = std::max(1, static_cast<int>(geo::ComputeDistance(stops_[from], stops_[to]) * curvature));
+        if (!road_distances_[from].count(to) && !road_distances_[to].count(from)) {
+            road_distances_[from][to] = distance;
+        }
+        if (!road_distances_[to].count(from) && unit(generator) < parameters_.distance_density) {
+            road_distances_[to][from] = distance + static_cast<int>(unit(generator) * 200);
+        }
+    };
+
+    std::uniform_int_distribution<int> random_stop(0, stop_count - 1);
+    std::uniform_int_distribution<int> random_length(std::max(parameters_.min_route_stops, 2),
+                                                     std::max(parameters_.max_route_stops, parameters_.min_route_stops));
+    for (int bus = 0; bus < parameters_.bus_count; ++bus) {
+        GeneratedBus generated;
+        generated.name = "Bus "s + std::to_string(bus);
+        generated.is_roundtrip = unit(generator) < parameters_.roundtrip_ratio;
+        const int length = random_length(generator);
+        while (generated.stops.size() < 2) {
+            generated.stops = {random_stop(generator)};
+            std::unordered_set<int> visited{generated.stops.front()};
+            while (static_cast<int>(generated.stops.size()) < length) {
+                const int current = generated.stops.back();
+                std::vector<int> candidates;
+                for (int row_shift = -1; row_shift <= 1; ++row_shift) {
+                    for (int column_shift = -1; column_shift <= 1; ++column_shift) {
+                        const int row = current / columns + row_shift;
+                        const int column = current % columns + column_shift;
+                        const int next = row * columns + column;
+                        if (row >= 0 && column >= 0 && column < columns && next < stop_count && !visited.count(next)) {
+                            candidates.push_back(next);
+                        }
+                    }
+                }
+                if (candidates.empty()) {
+                    break;
+                }
+                const int next = candidates[std::uniform_int_distribution<size_t>(0, candidates.size() - 1)(generator)];
+                visited.insert(next);
+                generated.stops.push_back(next);
+            }
+        }
+        if (generated.is_roundtrip) {
+            generated.stops.push_back(generated.stops.front());
+        }
+        for (size_t i = 1; i < generated.stops.size(); ++i) {
+            add_span(generated.stops[i - 1], generated.stops[i]);
+        }
+        buses_.push_back(std::move(generated));
+    }
+}
+
+std::string CityGenerator::GetStopName(int stop) const {
+    return "Stop "s + std::to_string(stop);
+}
+
+geo::Coordinates CityGenerator::GetRandomPoint(std::mt19937& generator) const {
+    const auto [min_lat, max_lat] = std::minmax_element(stops_.begin(), stops_.end(), [](auto lhs, auto rhs) {
+        return lhs.lat < rhs.lat;
+    });
+    const auto [min_lng, max_lng] = std::minmax_element(stops_.begin(), stops_.end(), [](auto lhs, auto rhs) {
+        return lhs.lng < rhs.lng;
+    });
+    std::uniform_real_distribution<double> lat(min_lat->lat, max_lat->lat);
+    std::uniform_real_distribution<double> lng(min_lng->lng, max_lng->lng);
+    return {lat(generator), lng(generator)};
+}
+
+json::Node CityGenerator::MakeBaseDocument(const std::filesystem::path& base_file) const {
+    json::Array base_requests;
+    for (size_t stop = 0; stop < stops_.size(); ++stop) {
+        json::Dict road_distances;
+        for (const auto& [to, distance] : road_distances_[stop]) {
+            road_distances.emplace(GetStopName(to), distance);
+        }
+        json::Dict request;
+        request.emplace("type"s, "Stop"s);
+        request.emplace("name"s, GetStopName(static_cast<int>(stop)));
+        request.emplace("latitude"s, stops_[stop].lat);
+        request.emplace("longitude"s, stops_[stop].lng);
+        request.emplace("road_distances"s, std::move(road_distances));
+        base_requests.emplace_back(std::move(request));
+    }
+    for (const GeneratedBus& bus : buses_) {
+        json::Array stops;
+        // Round trips list their full loop, the others only the way out.
+        for (int stop : bus.stops) {
+            stops.emplace_back(GetStopName(stop));
+        }
+        json::Dict request;
+        request.emplace("type"s, "Bus"s);
+        request.emplace("name"s, bus.name);
+        request.emplace("stops"s, std::move(stops));
+        request.emplace("is_roundtrip"s, bus.is_roundtrip);
+        base_requests.emplace_back(std::move(request));
+    }
+    json::Dict document;
+    document.emplace("serialization_settings"s, json::Dict{{"file"s, base_file.string()}});
+    document.emplace("render_settings"s, MakeRenderSettings());
+    document.emplace("routing_settings"s, MakeRoutingSettings());
+    document.emplace("base_requests"s, std::move(base_requests));
+    return document;
+}
+
+void CityGenerator::FillCatalogue(TransportCatalogue& catalogue) const {
+    for (size_t stop = 0; stop < stops_.size(); ++stop) {
+        std::vector<std::pair<std::string, double>> distances;
+        for (const auto& [to, distance] : road_distances_[stop]) {
+            distances.push_back({GetStopName(to), distance});
+        }
+        catalogue.AddStop(GetStopName(static_cast<int>(stop)), stops_[stop].lat, stops_[stop].lng, distances);
+    }
+    for (const GeneratedBus& bus : buses_) {
+        QueryInputBus query;
+        query.name = bus.name;
+        query.type = bus.is_roundtrip ? RouteType::CIRCLE : RouteType::TWO_DIRECTIONAL;
+        for (int stop : bus.stops) {
+            query.stops_list.push_back(GetStopName(stop));
+        }
+        catalogue.AddBus(query);
+    }
+    catalogue.BuildStopIndex();
+    catalogue.BuildStopComponents();
+}
+
+json::Array CityGenerator::MakeStatRequests(std::string_view type, int count, unsigned seed) const {
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> random_stop(0, static_cast<int>(stops_.size()) - 1);
+    std::uniform_int_distribution<size_t> random_bus(0, buses_.empty() ? 0 : buses_.size() - 1);
+    auto make_point = [this, &generator]() {
+        const geo::Coordinates point = GetRandomPoint(generator);
+        return json::Dict{{"latitude"s, point.lat}, {"longitude"s, point.lng}};
+    };
+    json::Array requests;
+    for (int id = 0; id < count; ++id) {
+        json::Dict request;
+        request.emplace("id"s, id);
+        if (type == "Bus"sv && !buses_.empty()) {
+            request.emplace("type"s, "Bus"s);
+            request.emplace("name"s, buses_[random_bus(generator)].name);
+        } else if (type == "Stop"sv) {
+              request.emplace("type"s, "Stop"s);
+              request.emplace("name"s, GetStopName(random_stop(generator)));
+          } else if (type == "Route"sv) {
+                request.emplace("type"s, "Route"s);
+                request.emplace("from"s, GetStopName(random_stop(generator)));
+                request.emplace("to"s, GetStopName(random_stop(generator)));
+            } else if (type == "PointRoute"sv) {
+                  request.emplace("type"s, "Route"s);
+                  request.emplace("from"s, make_point());
+                  request.emplace("to"s, make_point());
+              } else if (type == "NearbyStops"sv || type == "NearestStops"sv) {
+                    json::Dict point = make_point();
+                    request.insert(point.begin(), point.end());
+                    request.emplace("type"s, std::string{type});
+                    if (type == "NearbyStops"sv) {
+                        request.emplace("radius"s, 500);
+                    } else {
+                          request.emplace("count"s, 5);
+                      }
+                } else {
+                      request.emplace("type"s, "Map"s);
+                  }
+        requests.emplace_back(std::move(request));
+    }
+    return requests;
+}
+
+json::Dict MakeRenderSettings() {
+    json::Dict settings;
+    settings.emplace("width"s, 1200.);
+    settings.emplace("height"s, 1200.);
+    settings.emplace("padding"s, 50.);
+    settings.emplace("stop_radius"s, 3.);
+    settings.emplace("line_width"s, 10.);
+    settings.emplace("bus_label_font_size"s, 20);
+    settings.emplace("bus_label_offset"s, json::Array{7., 15.});
+    settings.emplace("stop_label_font_size"s, 14);
+    settings.emplace("stop_label_offset"s, json::Array{7., -3.});
+    settings.emplace("underlayer_color"s, json::Array{255, 255, 255, 0.85});
+    settings.emplace("underlayer_width"s, 3.);
+    settings.emplace("color_palette"s, json::Array{"green"s, json::Array{255, 160, 0}, "red"s});
+    return settings;
+}
+
+json::Dict MakeRoutingSettings() {
+    json::Dict settings;
+    settings.emplace("bus_wait_time"s, 6);
+    settings.emplace("bus_velocity"s, 40);
+    return settings;
+}
+
+} // namespace benchmark
+} // namespace transport_catalogue
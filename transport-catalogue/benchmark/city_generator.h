@@ -0,0 +1,61 @@
+#pragma once
+
+#include "../json.h"
+#include "../transport_catalogue.h"
+
+#include <random>
+
+namespace transport_catalogue {
+namespace benchmark {
+
+// Shape of a synthetic city. Stops sit on a jittered grid, and every bus is a
+// random walk over neighbouring grid cells, so routes stay local the way real ones do.
+struct CityParameters {
+    std::string name = "city";
+    int stop_count = 100;
+    int bus_count = 20;
+    int min_route_stops = 5;
+    int max_route_stops = 20;
+    double roundtrip_ratio = 0.3;
+    // Probability that the reverse direction of a span gets its own road distance.
+    double distance_density = 0.5;
+    double min_curvature = 1.1;
+    double max_curvature = 1.6;
+    double center_lat = 55.75;
+    double center_lng = 37.6;
+    double grid_step = 0.004;
+    unsigned seed = 42;
+};
+
+class CityGenerator {
+public:
+    explicit CityGenerator(CityParameters parameters);
+
+    const CityParameters& GetParameters() const;
+    // base_requests, render_settings and routing_settings of a make_base document.
+    json::Node MakeBaseDocument(const std::filesystem::path& base_file) const;
+    void FillCatalogue(TransportCatalogue& catalogue) const;
+    json::Array MakeStatRequests(std::string_view type, int count, unsigned seed) const;
+
+private:
+    struct GeneratedBus {
+        std::string name;
+        bool is_roundtrip = false;
+        std::vector<int> stops;
+    };
+
+    void Generate();
+    std::string GetStopName(int stop) const;
+    geo::Coordinates GetRandomPoint(std::mt19937& generator) const;
+
+    CityParameters parameters_;
+    std::vector<geo::Coordinates> stops_;
+    std::vector<std::map<int, int>> road_distances_;
+    std::vector<GeneratedBus> buses_;
+};
+
+json::Dict MakeRenderSettings();
+json::Dict MakeRoutingSettings();
+
+} // namespace benchmark
+} // namespace transport_catalogue
@@ -31,6 +31,11 @@
 namespace transport_catalogue {
     
 double KmDividedOnTime (double speed);
+
+// Vertex and edge ids as the routing graph and its all-pairs table store them.
+// 32-bit ids halve a table cell against size_t; the graph throws
+// std::length_error if a base ever outgrows them.
+using RouteIndex = uint32_t;
     
 enum class RouteType { 
     CIRCLE, 
@@ -39,18 +44,29 @@ enum class RouteType {
     
 struct Stop {
     std::string name;
-    geo::Coordinates coord;
-    int id;
+    geo::Coordinates coord{0, 0};
+    int id = 0;
+    // False for a stop known only from the road_distances of another stop.
+    bool has_coord = false;
 };
 
 using PairStop = std::pair<const Stop*, const Stop*>;
 using DeqStop = std::deque< Stop*>;
 using StringVec = std::vector<std::string>;
 
+// A trip is one run of the bus: a time in minutes from midnight for every
+// entry of stop_names.
+using Trip = std::vector<double>;
+
 struct Bus {
     std::string name_bus;
     DeqStop stop_names;
     RouteType type;
+    std::vector<Trip> trips;
+    // Road and great-circle distance from the first entry of stop_names to
+    // every entry, so the length of any part of the route is one subtraction.
+    std::vector<double> road_prefix;
+    std::vector<double> geo_prefix;
 };
 
 struct BusQueryInput {
@@ -65,6 +81,13 @@ struct QueryInputBus {
     std::string name;
     RouteType type;
     std::vector<std::string> stops_list;
+    std::vector<Trip> trips;
+};
+
+struct QueryInputStop {
+    std::string name;
+    geo::Coordinates coord;
+    std::vector<std::pair<std::string, double>> distances;
 };
 
 struct RouteStatistic{
@@ -82,7 +105,13 @@ struct RouteStatistic{
         std::string bus;
     };
 
-    using VariantItem = std::variant<ItemsBus, ItemsWait>;
+    struct ItemsWalk {
+        std::string type;
+        double time = 0;
+        double distance = 0;
+    };
+
+    using VariantItem = std::variant<ItemsBus, ItemsWait, ItemsWalk>;
 
     double total_time = 0;
     std::vector<VariantItem> items;
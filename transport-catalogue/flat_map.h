@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace transport_catalogue {
+
+// Map from string keys kept as one sorted vector of pairs. JSON objects are
+// small and mostly read, so a single contiguous allocation beats a node per
+// field; lookups are binary searches and iteration order matches std::map.
+template <typename Value>
+class FlatMap {
+public:
+    using key_type = std::string;
+    using mapped_type = Value;
+    using value_type = std::pair<std::string, Value>;
+    using iterator = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    FlatMap() = default;
+
+    FlatMap(std::initializer_list<value_type> items) {
+        items_.reserve(items.size());
+        for (const value_type& item : items) {
+            emplace(item.first, item.second);
+        }
+    }
+
+    // Takes unsorted items; the first one wins for a repeated key, as with
+    // consecutive emplace calls. Objects often come in sorted already, which
+    // is checked before paying for a stable sort.
+    explicit FlatMap(std::vector<value_type> items) : items_(std::move(items)) {
+        const auto key_less = [](const value_type& lhs, const value_type& rhs) {
+            return lhs.first < rhs.first;
+        };
+        if (!std::is_sorted(items_.begin(), items_.end(), key_less)) {
+            std::stable_sort(items_.begin(), items_.end(), key_less);
+        }
+        items_.erase(std::unique(items_.begin(), items_.end(), [](const value_type& lhs, const value_type& rhs) {
+            return lhs.first == rhs.first;
+        }), items_.end());
+    }
+
+    iterator begin() {
+        return items_.begin();
+    }
+    iterator end() {
+        return items_.end();
+    }
+    const_iterator begin() const {
+        return items_.begin();
+    }
+    const_iterator end() const {
+        return items_.end();
+    }
+
+    size_t size() const {
+        return items_.size();
+    }
+    bool empty() const {
+        return items_.empty();
+    }
+    void reserve(size_t size) {
+        items_.reserve(size);
+    }
+    void clear() {
+        items_.clear();
+    }
+
+    iterator find(std::string_view key) {
+        const auto it = LowerBound(key);
+        return it != items_.end() && it->first == key ? it : items_.end();
+    }
+    const_iterator find(std::string_view key) const {
+        const auto it = LowerBound(key);
+        return it != items_.end() && it->first == key ? it : items_.end();
+    }
+    size_t count(std::string_view key) const {
+        return find(key) != end() ? 1 : 0;
+    }
+
+    Value& at(std::string_view key) {
+        const auto it = find(key);
+        if (it == items_.end()) {
+            throw std::out_of_range("FlatMap::at: no key " + std::string{key});
+        }
+        return it->second;
+    }
+    const Value& at(std::string_view key) const {
+        const auto it = find(key);
+        if (it == items_.end()) {
+            throw std::out_of_range("FlatMap::at: no key " + std::string{key});
+        }
+        return it->second;
+    }
+    Value& operator[](const std::string& key) {
+        return emplace(key, Value{}).first->second;
+    }
+
+    template <typename Key, typename... Args>
+    std::pair<iterator, bool> emplace(Key&& key, Args&&... args) {
+        std::string owned_key(std::forward<Key>(key));
+        auto it = LowerBound(owned_key);
+        if (it != items_.end() && it->first == owned_key) {
+            return {it, false};
+        }
+        it = items_.emplace(it, std::piecewise_construct, std::forward_as_tuple(std::move(owned_key)), std::forward_as_tuple(std::forward<Args>(args)...));
+        return {it, true};
+    }
+    std::pair<iterator, bool> insert(value_type item) {
+        return emplace(std::move(item.first), std::move(item.second));
+    }
+    template <typename InputIt>
+    void insert(InputIt first, InputIt last) {
+        for (; first != last; ++first) {
+            emplace(first->first, first->second);
+        }
+    }
+    size_t erase(std::string_view key) {
+        const auto it = find(key);
+        if (it == items_.end()) {
+            return 0;
+        }
+        items_.erase(it);
+        return 1;
+    }
+
+    bool operator==(const FlatMap& other) const {
+        return items_ == other.items_;
+    }
+    bool operator!=(const FlatMap& other) const {
+        return !(*this == other);
+    }
+
+private:
+    static bool KeyLess(const value_type& item, std::string_view key) {
+        return std::string_view{item.first} < key;
+    }
+    iterator LowerBound(std::string_view key) {
+        return std::lower_bound(items_.begin(), items_.end(), key, KeyLess);
+    }
+    const_iterator LowerBound(std::string_view key) const {
+        return std::lower_bound(items_.begin(), items_.end(), key, KeyLess);
+    }
+
+    std::vector<value_type> items_;
+};
+
+} // namespace transport_catalogue
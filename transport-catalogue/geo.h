@@ -1,6 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <vector>
 
 namespace transport_catalogue {
 namespace geo {
@@ -16,16 +20,131 @@ struct Coordinates {
     }
 };
 
+inline const double EARTH_RADIUS = 6371000;
+inline const double DEGREES_TO_RADIANS = 3.1415926535 / 180.;
+
 inline double ComputeDistance(Coordinates from, Coordinates to) {
     using namespace std;
     if (from == to) {
         return 0;
     }
-    static const double dr = 3.1415926535 / 180.;
+    static const double dr = DEGREES_TO_RADIANS;
     return acos(sin(from.lat * dr) * sin(to.lat * dr)
                 + cos(from.lat * dr) * cos(to.lat * dr) * cos(abs(from.lng - to.lng) * dr))
-        * 6371000;
+        * EARTH_RADIUS;
+}
+
+// Position of the cell (x, y) along the Hilbert curve that fills a 2^order square.
+inline uint64_t HilbertIndex(uint32_t x, uint32_t y, int order) {
+    uint64_t result = 0;
+    for (uint32_t side = 1u << (order - 1); side > 0; side >>= 1) {
+        const uint32_t rx = (x & side) ? 1 : 0;
+        const uint32_t ry = (y & side) ? 1 : 0;
+        result += static_cast<uint64_t>(side) * side * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return result;
+}
+
+// Indices of the points in the order the Hilbert curve over their bounding box
+// visits them, so that points close on the map stay close in the sequence.
+inline std::vector<size_t> HilbertOrder(const std::vector<Coordinates>& points) {
+    constexpr int ORDER = 16;
+    constexpr double CELLS = (1u << ORDER) - 1;
+    std::vector<size_t> result(points.size());
+    std::iota(result.begin(), result.end(), size_t{0});
+    if (points.empty()) {
+        return result;
+    }
+    const auto [min_lat, max_lat] = std::minmax_element(points.begin(), points.end(), [](Coordinates lhs, Coordinates rhs) {
+        return lhs.lat < rhs.lat;
+    });
+    const auto [min_lng, max_lng] = std::minmax_element(points.begin(), points.end(), [](Coordinates lhs, Coordinates rhs) {
+        return lhs.lng < rhs.lng;
+    });
+    const double lat_scale = max_lat->lat > min_lat->lat ? CELLS / (max_lat->lat - min_lat->lat) : 0;
+    const double lng_scale = max_lng->lng > min_lng->lng ? CELLS / (max_lng->lng - min_lng->lng) : 0;
+    std::vector<uint64_t> keys(points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        keys[i] = HilbertIndex(static_cast<uint32_t>((points[i].lng - min_lng->lng) * lng_scale),
+                               static_cast<uint32_t>((points[i].lat - min_lat->lat) * lat_scale), ORDER);
+    }
+    std::stable_sort(result.begin(), result.end(), [&keys](size_t lhs, size_t rhs) {
+        return keys[lhs] < keys[rhs];
+    });
+    return result;
 }
 
+struct UnitVector {
+    double x = 0;
+    double y = 0;
+    double z = 0;
+};
+
+inline UnitVector ToUnitVector(Coordinates coord) {
+    const double lat = coord.lat * DEGREES_TO_RADIANS;
+    const double lng = coord.lng * DEGREES_TO_RADIANS;
+    return {std::cos(lat) * std::cos(lng), std::cos(lat) * std::sin(lng), std::sin(lat)};
+}
+
+// Points on the unit sphere stored as separate x/y/z arrays, so that trigonometry
+// is paid once per point instead of once per distance computation.
+class UnitSphereArray {
+public:
+    size_t Size() const {
+        return x_.size();
+    }
+
+    void Resize(size_t size) {
+        x_.resize(size);
+        y_.resize(size);
+        z_.resize(size);
+    }
+
+    void Set(size_t index, Coordinates coord) {
+        if (index >= Size()) {
+            Resize(index + 1);
+        }
+        const UnitVector point = ToUnitVector(coord);
+        x_[index] = point.x;
+        y_[index] = point.y;
+        z_[index] = point.z;
+    }
+
+    double X(size_t index) const {
+        return x_[index];
+    }
+    double Y(size_t index) const {
+        return y_[index];
+    }
+    double Z(size_t index) const {
+        return z_[index];
+    }
+
+    // Great-circle distance between two stored points. The chord form stays exact
+    // for coinciding points and well-conditioned for short spans, unlike acos.
+    double ComputeDistance(size_t from, size_t to) const {
+        const double dx = x_[from] - x_[to];
+        const double dy = y_[from] - y_[to];
+        const double dz = z_[from] - z_[to];
+        return ChordToDistance(std::sqrt(dx * dx + dy * dy + dz * dz));
+    }
+
+    static double ChordToDistance(double chord) {
+        return 2 * std::asin(std::min(chord * 0.5, 1.)) * EARTH_RADIUS;
+    }
+
+private:
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<double> z_;
+};
+
 } // namespace geo
 } // namespace transport_catalogue 
@@ -3,6 +3,8 @@
 #include "ranges.h"
 
 #include <cstdlib>
+#include <limits>
+#include <stdexcept>
 #include <vector>
 
 namespace graph {
@@ -10,65 +12,113 @@ namespace graph {
 using VertexId = size_t;
 using EdgeId = size_t;
 
-template <typename Weight>
+// Index is the type the graph stores vertex and edge ids in; the interface
+// takes and returns VertexId and EdgeId regardless, so a 32-bit Index only
+// changes the footprint.
+template <typename Weight, typename Index = size_t>
 struct Edge {
-    VertexId from;
-    VertexId to;
+    Index from;
+    Index to;
     Weight weight;
 };
 
-template <typename Weight>
+// Incidence is kept in compressed sparse row form: the outgoing edges of
+// vertex v are incidence_[offsets_[v] .. offsets_[v + 1]), in edge id order.
+template <typename Weight, typename Index = size_t>
 class DirectedWeightedGraph {
 private:
-    using IncidenceList = std::vector<EdgeId>;
+    using IncidenceList = std::vector<Index>;
     using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
 
 public:
     DirectedWeightedGraph() = default;
     explicit DirectedWeightedGraph(size_t vertex_count);
-    EdgeId AddEdge(const Edge<Weight>& edge);
+    // Bulk construction: edge ids are the positions in edges.
+    DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight, Index>> edges);
+    // Shifts the incidence of all later vertices, so prefer the bulk
+    // constructor for anything but a few additions.
+    EdgeId AddEdge(const Edge<Weight, Index>& edge);
 
     size_t GetVertexCount() const;
     size_t GetEdgeCount() const;
-    const Edge<Weight>& GetEdge(EdgeId edge_id) const;
+    const Edge<Weight, Index>& GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
 
+    // The largest id is left free, so that users of the graph can keep it as "no edge".
+    static constexpr size_t MAX_COUNT = std::numeric_limits<Index>::max();
+
 private:
-    std::vector<Edge<Weight>> edges_;
-    std::vector<IncidenceList> incidence_lists_;
+    static void CheckCount(size_t count);
+
+    std::vector<Edge<Weight, Index>> edges_;
+    std::vector<Index> offsets_;
+    IncidenceList incidence_;
 };
 
-template <typename Weight>
-DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
-    : incidence_lists_(vertex_count) {
+template <typename Weight, typename Index>
+void DirectedWeightedGraph<Weight, Index>::CheckCount(size_t count) {
+    if (count >= MAX_COUNT) {
+        throw std::length_error("Graph is too large for its index type");
+    }
+}
+
+template <typename Weight, typename Index>
+DirectedWeightedGraph<Weight, Index>::DirectedWeightedGraph(size_t vertex_count)
+    : offsets_(vertex_count + 1, 0) {
+    CheckCount(vertex_count);
+}
+
+template <typename Weight, typename Index>
+DirectedWeightedGraph<Weight, Index>::DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight, Index>> edges)
+    : edges_(std::move(edges))
+    , offsets_(vertex_count + 1, 0)
+    , incidence_(edges_.size()) {
+    CheckCount(vertex_count);
+    CheckCount(edges_.size());
+    // Counting sort by source vertex; stable, so each row stays in id order.
+    for (const Edge<Weight, Index>& edge : edges_) {
+        ++offsets_.at(edge.from + 1);
+    }
+    for (size_t vertex = 0; vertex < vertex_count; ++vertex) {
+        offsets_[vertex + 1] += offsets_[vertex];
+    }
+    std::vector<Index> next(offsets_.begin(), offsets_.end() - 1);
+    for (EdgeId id = 0; id < edges_.size(); ++id) {
+        incidence_[next[edges_[id].from]++] = static_cast<Index>(id);
+    }
 }
 
-template <typename Weight>
-EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
+template <typename Weight, typename Index>
+EdgeId DirectedWeightedGraph<Weight, Index>::AddEdge(const Edge<Weight, Index>& edge) {
+    CheckCount(edges_.size() + 1);
+    const size_t position = offsets_.at(edge.from + 1);
     edges_.push_back(edge);
     const EdgeId id = edges_.size() - 1;
-    incidence_lists_.at(edge.from).push_back(id);
+    incidence_.insert(incidence_.begin() + position, static_cast<Index>(id));
+    for (size_t vertex = edge.from + 1; vertex < offsets_.size(); ++vertex) {
+        ++offsets_[vertex];
+    }
     return id;
 }
 
-template <typename Weight>
-size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-    return incidence_lists_.size();
+template <typename Weight, typename Index>
+size_t DirectedWeightedGraph<Weight, Index>::GetVertexCount() const {
+    return offsets_.empty() ? 0 : offsets_.size() - 1;
 }
 
-template <typename Weight>
-size_t DirectedWeightedGraph<Weight>::GetEdgeCount() const {
+template <typename Weight, typename Index>
+size_t DirectedWeightedGraph<Weight, Index>::GetEdgeCount() const {
     return edges_.size();
 }
 
-template <typename Weight>
-const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
+template <typename Weight, typename Index>
+const Edge<Weight, Index>& DirectedWeightedGraph<Weight, Index>::GetEdge(EdgeId edge_id) const {
     return edges_.at(edge_id);
 }
 
-template <typename Weight>
-typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
-DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
-    return ranges::AsRange(incidence_lists_.at(vertex));
+template <typename Weight, typename Index>
+typename DirectedWeightedGraph<Weight, Index>::IncidentEdgesRange
+DirectedWeightedGraph<Weight, Index>::GetIncidentEdges(VertexId vertex) const {
+    return ranges::Range(incidence_.begin() + offsets_.at(vertex), incidence_.begin() + offsets_.at(vertex + 1));
 }
 }  // namespace graph
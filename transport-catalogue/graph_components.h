@@ -0,0 +1,117 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Component labels of every vertex. Strong components are numbered in the
+// order Tarjan's algorithm closes them, so an edge never leads to a strong
+// component with a larger number.
+struct Components {
+    std::vector<uint32_t> strong;
+    std::vector<uint32_t> weak;
+
+    size_t Size() const {
+        return strong.size();
+    }
+
+    // False only when there is certainly no path from -> to.
+    bool MayReach(VertexId from, VertexId to) const {
+        return weak[from] == weak[to] && strong[from] >= strong[to];
+    }
+
+    // True only when a path from -> to certainly exists.
+    bool Reaches(VertexId from, VertexId to) const {
+        return strong[from] == strong[to];
+    }
+};
+
+// Iterative Tarjan for the strong components and union-find for the weak ones.
+template <typename Weight, typename Index>
+Components ComputeComponents(const DirectedWeightedGraph<Weight, Index>& graph) {
+    const size_t vertex_count = graph.GetVertexCount();
+    constexpr uint32_t UNVISITED = UINT32_MAX;
+    Components result{std::vector<uint32_t>(vertex_count, UNVISITED), std::vector<uint32_t>(vertex_count)};
+
+    std::vector<uint32_t> index(vertex_count, UNVISITED);
+    std::vector<uint32_t> low(vertex_count);
+    std::vector<VertexId> stack;
+    // Vertex and the position of the next incident edge to look at.
+    std::vector<std::pair<VertexId, size_t>> calls;
+    uint32_t next_index = 0;
+    uint32_t next_component = 0;
+    for (VertexId root = 0; root < vertex_count; ++root) {
+        if (index[root] != UNVISITED) {
+            continue;
+        }
+        calls.push_back({root, 0});
+        while (!calls.empty()) {
+            auto& [vertex, position] = calls.back();
+            if (position == 0) {
+                index[vertex] = low[vertex] = next_index++;
+                stack.push_back(vertex);
+            }
+            const auto edges = graph.GetIncidentEdges(vertex);
+            bool descended = false;
+            while (position < static_cast<size_t>(edges.end() - edges.begin())) {
+                const VertexId next = graph.GetEdge(*(edges.begin() + position++)).to;
+                if (index[next] == UNVISITED) {
+                    calls.push_back({next, 0});
+                    descended = true;
+                    break;
+                }
+                if (result.strong[next] == UNVISITED) {
+                    low[vertex] = std::min(low[vertex], index[next]);
+                }
+            }
+            if (descended) {
+                continue;
+            }
+            const VertexId finished = vertex;
+            if (low[finished] == index[finished]) {
+                VertexId member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    result.strong[member] = next_component;
+                } while (member != finished);
+                ++next_component;
+            }
+            calls.pop_back();
+            if (!calls.empty()) {
+                const VertexId parent = calls.back().first;
+                low[parent] = std::min(low[parent], low[finished]);
+            }
+        }
+    }
+
+    std::vector<VertexId> parents(vertex_count);
+    std::iota(parents.begin(), parents.end(), VertexId{0});
+    const auto find = [&parents](VertexId vertex) {
+        while (parents[vertex] != vertex) {
+            vertex = parents[vertex] = parents[parents[vertex]];
+        }
+        return vertex;
+    };
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        const VertexId from = find(edge.from);
+        const VertexId to = find(edge.to);
+        if (from != to) {
+            parents[std::max(from, to)] = std::min(from, to);
+        }
+    }
+    // Weak labels are the smallest vertex of the component.
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        result.weak[vertex] = static_cast<uint32_t>(find(vertex));
+    }
+    return result;
+}
+
+}  // namespace graph
@@ -0,0 +1,310 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Per-query Dijkstra over a DirectedWeightedGraph. Unlike Router it needs no
+// precomputation, and it can start from several vertices and stop at whichever
+// of several targets is cheapest once each vertex's entry/exit cost is added.
+// With a heuristic set it runs as A*.
+template <typename Weight, typename Index = size_t>
+class ShortestPathSearch {
+private:
+    using Graph = DirectedWeightedGraph<Weight, Index>;
+
+public:
+    struct Terminal {
+        VertexId vertex;
+        Weight weight;
+    };
+
+    struct RouteInfo {
+        VertexId source;
+        VertexId target;
+        Weight weight;
+        std::vector<EdgeId> edges;
+    };
+
+    // Lower bound on the weight still needed to leave through the cheapest
+    // target, exit weight included.
+    using Heuristic = std::function<Weight(VertexId)>;
+    // Replaces the stored weight of every edge the search relaxes.
+    using EdgeWeight = std::function<Weight(EdgeId)>;
+
+    // Blocked edges and vertices as masks over the graph. Searches may share
+    // one, so that the masks are sized once rather than per search; a search
+    // leaves it cleared when it ends.
+    struct BlockMasks {
+        std::vector<bool> edges;
+        std::vector<bool> vertices;
+        // Set entries of the masks, so that clearing does not touch the rest.
+        std::vector<EdgeId> edge_ids;
+        std::vector<VertexId> vertex_ids;
+    };
+
+    explicit ShortestPathSearch(const Graph& graph, BlockMasks* masks = nullptr);
+    ShortestPathSearch(const ShortestPathSearch&) = delete;
+    ShortestPathSearch& operator=(const ShortestPathSearch&) = delete;
+    ~ShortestPathSearch();
+
+    std::optional<RouteInfo> BuildRoute(const std::vector<Terminal>& sources, const std::vector<Terminal>& targets);
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to);
+    // Routes from one source to each of targets out of a single search, which
+    // ends once every target is settled. No one target can guide it, so the
+    // heuristic is not used.
+    std::vector<std::optional<RouteInfo>> BuildRoutes(VertexId from, const std::vector<VertexId>& targets);
+
+    size_t GetSettledCount() const;
+
+    // The bound must be consistent: it never drops along an edge by more than
+    // the edge weight. Routes stay exact, the search just settles fewer vertices.
+    void SetHeuristic(Heuristic heuristic);
+    void SetEdgeWeight(EdgeWeight edge_weight);
+
+    // Excluded from the following searches until ClearBlocked. A blocked
+    // vertex can still be a source, but is never entered.
+    void BlockEdge(EdgeId edge_id);
+    void BlockVertex(VertexId vertex);
+    void ClearBlocked();
+
+private:
+    struct VertexData {
+        std::optional<Weight> weight;
+        std::optional<EdgeId> prev_edge;
+        VertexId source = 0;
+        bool settled = false;
+    };
+
+    Weight GetQueueKey(Weight weight, VertexId vertex) const;
+    std::vector<EdgeId> GetPathEdges(VertexId target) const;
+    void AllocateBlocked();
+
+    const Graph& graph_;
+    std::vector<VertexData> vertices_;
+    size_t settled_count_ = 0;
+    Heuristic heuristic_;
+    EdgeWeight edge_weight_;
+    BlockMasks own_masks_;
+    BlockMasks& masks_;
+};
+
+template <typename Weight, typename Index>
+ShortestPathSearch<Weight, Index>::ShortestPathSearch(const Graph& graph, BlockMasks* masks)
+    : graph_(graph)
+    , masks_(masks ? *masks : own_masks_) {
+}
+
+template <typename Weight, typename Index>
+ShortestPathSearch<Weight, Index>::~ShortestPathSearch() {
+    ClearBlocked();
+}
+
+template <typename Weight, typename Index>
+std::optional<typename ShortestPathSearch<Weight, Index>::RouteInfo>
+ShortestPathSearch<Weight, Index>::BuildRoute(VertexId from, VertexId to) {
+    return BuildRoute({{from, Weight{}}}, {{to, Weight{}}});
+}
+
+template <typename Weight, typename Index>
+std::optional<typename ShortestPathSearch<Weight, Index>::RouteInfo>
+ShortestPathSearch<Weight, Index>::BuildRoute(const std::vector<Terminal>& sources, const std::vector<Terminal>& targets) {
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    vertices_.assign(graph_.GetVertexCount(), VertexData{});
+    settled_count_ = 0;
+    const bool has_blocked = !masks_.edge_ids.empty() || !masks_.vertex_ids.empty();
+
+    std::vector<std::optional<Weight>> exit_weights(graph_.GetVertexCount());
+    for (const Terminal& target : targets) {
+        auto& exit_weight = exit_weights.at(target.vertex);
+        if (!exit_weight || target.weight < *exit_weight) {
+            exit_weight = target.weight;
+        }
+    }
+    for (const Terminal& source : sources) {
+        VertexData& data = vertices_.at(source.vertex);
+        if (!data.weight || source.weight < *data.weight) {
+            data = {source.weight, std::nullopt, source.vertex, false};
+            queue.push({GetQueueKey(source.weight, source.vertex), source.vertex});
+        }
+    }
+
+    std::optional<Weight> best_weight;
+    VertexId best_target = 0;
+    while (!queue.empty()) {
+        const auto [key, vertex] = queue.top();
+        queue.pop();
+        if (best_weight && !(key < *best_weight)) {
+            break;
+        }
+        VertexData& data = vertices_[vertex];
+        if (data.settled) {
+            continue;
+        }
+        const Weight weight = *data.weight;
+        data.settled = true;
+        ++settled_count_;
+        if (const auto& exit_weight = exit_weights[vertex]) {
+            const Weight total = weight + *exit_weight;
+            if (!best_weight || total < *best_weight) {
+                best_weight = total;
+                best_target = vertex;
+            }
+        }
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            if (has_blocked && (masks_.edges[edge_id] || masks_.vertices[edge.to])) {
+                continue;
+            }
+            VertexData& next = vertices_[edge.to];
+            const Weight candidate = weight + (edge_weight_ ? edge_weight_(edge_id) : edge.weight);
+            if (!next.settled && (!next.weight || candidate < *next.weight)) {
+                next = {candidate, edge_id, data.source, false};
+                queue.push({GetQueueKey(candidate, edge.to), edge.to});
+            }
+        }
+    }
+    if (!best_weight) {
+        return std::nullopt;
+    }
+    return RouteInfo{vertices_[best_target].source, best_target, *best_weight, GetPathEdges(best_target)};
+}
+
+template <typename Weight, typename Index>
+std::vector<std::optional<typename ShortestPathSearch<Weight, Index>::RouteInfo>>
+ShortestPathSearch<Weight, Index>::BuildRoutes(VertexId from, const std::vector<VertexId>& targets) {
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    vertices_.assign(graph_.GetVertexCount(), VertexData{});
+    settled_count_ = 0;
+    const bool has_blocked = !masks_.edge_ids.empty() || !masks_.vertex_ids.empty();
+
+    std::vector<bool> is_target(graph_.GetVertexCount(), false);
+    size_t remaining = 0;
+    for (const VertexId target : targets) {
+        if (!is_target.at(target)) {
+            is_target[target] = true;
+            ++remaining;
+        }
+    }
+    vertices_.at(from) = {Weight{}, std::nullopt, from, false};
+    queue.push({Weight{}, from});
+    while (!queue.empty() && remaining > 0) {
+        const VertexId vertex = queue.top().second;
+        queue.pop();
+        VertexData& data = vertices_[vertex];
+        if (data.settled) {
+            continue;
+        }
+        const Weight weight = *data.weight;
+        data.settled = true;
+        ++settled_count_;
+        if (is_target[vertex]) {
+            --remaining;
+        }
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            if (has_blocked && (masks_.edges[edge_id] || masks_.vertices[edge.to])) {
+                continue;
+            }
+            VertexData& next = vertices_[edge.to];
+            const Weight candidate = weight + (edge_weight_ ? edge_weight_(edge_id) : edge.weight);
+            if (!next.settled && (!next.weight || candidate < *next.weight)) {
+                next = {candidate, edge_id, from, false};
+                queue.push({candidate, edge.to});
+            }
+        }
+    }
+
+    std::vector<std::optional<RouteInfo>> routes(targets.size());
+    for (size_t i = 0; i < targets.size(); ++i) {
+        const VertexData& data = vertices_[targets[i]];
+        if (data.settled) {
+            routes[i] = RouteInfo{from, targets[i], *data.weight, GetPathEdges(targets[i])};
+        }
+    }
+    return routes;
+}
+
+template <typename Weight, typename Index>
+std::vector<EdgeId> ShortestPathSearch<Weight, Index>::GetPathEdges(VertexId target) const {
+    std::vector<EdgeId> edges;
+    for (std::optional<EdgeId> edge_id = vertices_[target].prev_edge;
+         edge_id;
+         edge_id = vertices_[graph_.GetEdge(*edge_id).from].prev_edge)
+    {
+        edges.push_back(*edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+    return edges;
+}
+
+template <typename Weight, typename Index>
+size_t ShortestPathSearch<Weight, Index>::GetSettledCount() const {
+    return settled_count_;
+}
+
+template <typename Weight, typename Index>
+void ShortestPathSearch<Weight, Index>::SetHeuristic(Heuristic heuristic) {
+    heuristic_ = std::move(heuristic);
+}
+
+template <typename Weight, typename Index>
+void ShortestPathSearch<Weight, Index>::SetEdgeWeight(EdgeWeight edge_weight) {
+    edge_weight_ = std::move(edge_weight);
+}
+
+template <typename Weight, typename Index>
+Weight ShortestPathSearch<Weight, Index>::GetQueueKey(Weight weight, VertexId vertex) const {
+    return heuristic_ ? weight + heuristic_(vertex) : weight;
+}
+
+// The masks are only sized once something is blocked, so plain searches pay
+// nothing; shared masks are sized again only for a graph of another size.
+template <typename Weight, typename Index>
+void ShortestPathSearch<Weight, Index>::AllocateBlocked() {
+    if (masks_.edges.size() != graph_.GetEdgeCount() + 1 || masks_.vertices.size() != graph_.GetVertexCount()) {
+        masks_.edges.assign(graph_.GetEdgeCount() + 1, false);
+        masks_.vertices.assign(graph_.GetVertexCount(), false);
+    }
+}
+
+template <typename Weight, typename Index>
+void ShortestPathSearch<Weight, Index>::BlockEdge(EdgeId edge_id) {
+    AllocateBlocked();
+    if (!masks_.edges.at(edge_id)) {
+        masks_.edges[edge_id] = true;
+        masks_.edge_ids.push_back(edge_id);
+    }
+}
+
+template <typename Weight, typename Index>
+void ShortestPathSearch<Weight, Index>::BlockVertex(VertexId vertex) {
+    AllocateBlocked();
+    if (!masks_.vertices.at(vertex)) {
+        masks_.vertices[vertex] = true;
+        masks_.vertex_ids.push_back(vertex);
+    }
+}
+
+template <typename Weight, typename Index>
+void ShortestPathSearch<Weight, Index>::ClearBlocked() {
+    for (const EdgeId edge_id : masks_.edge_ids) {
+        masks_.edges[edge_id] = false;
+    }
+    for (const VertexId vertex : masks_.vertex_ids) {
+        masks_.vertices[vertex] = false;
+    }
+    masks_.edge_ids.clear();
+    masks_.vertex_ids.clear();
+}
+
+}  // namespace graph
@@ -0,0 +1,148 @@
+#include "implicit_search.h"
+
+#include <algorithm>
+#include <queue>
+#include <utility>
+
+namespace transport_catalogue {
+
+void StopCalls::Build(const TransportCatalogue& catalogue) {
+    const std::deque<Bus>& buses = catalogue.GetAllBuses();
+    offsets_.assign(catalogue.GetAllStops().size() + 1, 0);
+    for (const Bus& bus : buses) {
+        for (const Stop* stop : bus.stop_names) {
+            ++offsets_[stop->id + 1];
+        }
+    }
+    for (size_t stop = 1; stop < offsets_.size(); ++stop) {
+        offsets_[stop] += offsets_[stop - 1];
+    }
+    calls_.resize(offsets_.back());
+    std::vector<size_t> next(offsets_.begin(), offsets_.end() - 1);
+    for (size_t bus = 0; bus < buses.size(); ++bus) {
+        const DeqStop& stop_names = buses[bus].stop_names;
+        for (size_t index = 0; index < stop_names.size(); ++index) {
+            calls_[next[stop_names[index]->id]++] = {static_cast<uint32_t>(bus), static_cast<uint32_t>(index)};
+        }
+    }
+}
+
+ranges::Range<std::vector<StopCalls::Call>::const_iterator> StopCalls::GetCalls(size_t stop) const {
+    return {calls_.begin() + offsets_.at(stop), calls_.begin() + offsets_.at(stop + 1)};
+}
+
+size_t StopCalls::GetStopCount() const {
+    return offsets_.empty() ? 0 : offsets_.size() - 1;
+}
+
+ImplicitRouteSearch::ImplicitRouteSearch(const std::deque<Bus>& buses, const StopCalls& calls)
+    : buses_(buses)
+    , calls_(calls) {
+}
+
+std::optional<ImplicitRouteSearch::RouteInfo>
+ImplicitRouteSearch::BuildRoute(const std::vector<Terminal>& sources, const std::vector<Terminal>& targets,
+                                double bus_wait_time, double bus_velocity) {
+    using QueueItem = std::pair<double, graph::VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    stops_.assign(calls_.GetStopCount(), StopData{});
+    settled_count_ = 0;
+    const double meters_per_minute = KmDividedOnTime(bus_velocity);
+
+    std::vector<std::optional<double>> exit_weights(stops_.size());
+    for (const Terminal& target : targets) {
+        auto& exit_weight = exit_weights.at(target.vertex);
+        if (!exit_weight || target.weight < *exit_weight) {
+            exit_weight = target.weight;
+        }
+    }
+    for (const Terminal& source : sources) {
+        StopData& data = stops_.at(source.vertex);
+        if (!data.weight || source.weight < *data.weight) {
+            data = {source.weight, std::nullopt, source.vertex, false};
+            queue.push({GetQueueKey(source.weight, source.vertex), source.vertex});
+        }
+    }
+
+    std::optional<double> best_weight;
+    graph::VertexId best_target = 0;
+    while (!queue.empty()) {
+        const auto [key, stop] = queue.top();
+        queue.pop();
+        if (best_weight && !(key < *best_weight)) {
+            break;
+        }
+        StopData& data = stops_[stop];
+        if (data.settled) {
+            continue;
+        }
+        data.settled = true;
+        ++settled_count_;
+        const double weight = *data.weight;
+        if (const auto& exit_weight = exit_weights[stop]) {
+            const double total = weight + *exit_weight;
+            if (!best_weight || total < *best_weight) {
+                best_weight = total;
+                best_target = stop;
+            }
+        }
+        for (const StopCalls::Call& call : calls_.GetCalls(stop)) {
+            if (!suspended_buses_.empty() && suspended_buses_[call.bus]) {
+                continue;
+            }
+            const Bus& bus = buses_[call.bus];
+            for (size_t index = call.index + 1; index < bus.stop_names.size(); ++index) {
+                const auto next_stop = static_cast<graph::VertexId>(bus.stop_names[index]->id);
+                if (!closed_stops_.empty() && closed_stops_[next_stop]) {
+                    continue;
+                }
+                StopData& next = stops_[next_stop];
+                const double candidate = weight + ((bus.road_prefix[index] - bus.road_prefix[call.index]) / meters_per_minute + bus_wait_time);
+                if (!next.settled && (!next.weight || candidate < *next.weight)) {
+                    next = {candidate, Ride{call.bus, call.index, static_cast<uint32_t>(index)}, data.source, false};
+                    queue.push({GetQueueKey(candidate, next_stop), next_stop});
+                }
+            }
+        }
+    }
+    if (!best_weight) {
+        return std::nullopt;
+    }
+    std::vector<Ride> rides;
+    for (std::optional<Ride> ride = stops_[best_target].prev_ride;
+         ride;
+         ride = stops_[buses_[ride->bus].stop_names[ride->from_index]->id].prev_ride)
+    {
+        rides.push_back(*ride);
+    }
+    std::reverse(rides.begin(), rides.end());
+    return RouteInfo{stops_[best_target].source, best_target, *best_weight, std::move(rides)};
+}
+
+size_t ImplicitRouteSearch::GetSettledCount() const {
+    return settled_count_;
+}
+
+void ImplicitRouteSearch::SetHeuristic(Heuristic heuristic) {
+    heuristic_ = std::move(heuristic);
+}
+
+void ImplicitRouteSearch::CloseStop(size_t stop) {
+    if (closed_stops_.empty()) {
+        closed_stops_.assign(calls_.GetStopCount(), false);
+    }
+    closed_stops_.at(stop) = true;
+}
+
+void ImplicitRouteSearch::SuspendBus(size_t bus) {
+    if (suspended_buses_.empty()) {
+        suspended_buses_.assign(buses_.size(), false);
+    }
+    suspended_buses_.at(bus) = true;
+}
+
+double ImplicitRouteSearch::GetQueueKey(double weight, graph::VertexId stop) const {
+    return heuristic_ ? weight + heuristic_(stop) : weight;
+}
+
+}  // namespace transport_catalogue
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "graph_search.h"
+#include "ranges.h"
+#include "transport_catalogue.h"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+namespace transport_catalogue {
+
+// Where the buses call at every stop: the calls at stop s are
+// calls_[offsets_[s] .. offsets_[s + 1]), by bus and then by position.
+class StopCalls {
+public:
+    struct Call {
+        uint32_t bus;
+        uint32_t index;
+    };
+
+    void Build(const TransportCatalogue& catalogue);
+    ranges::Range<std::vector<Call>::const_iterator> GetCalls(size_t stop) const;
+    size_t GetStopCount() const;
+
+private:
+    std::vector<size_t> offsets_;
+    std::vector<Call> calls_;
+};
+
+// Dijkstra over stops that expands the rides of a bus straight from its
+// prefix distances instead of reading materialized edges: from the i-th stop
+// of a route every later stop j is one ride of prefix[j] - prefix[i] metres.
+// Memory stays linear in the total route length. Apart from the edge source
+// it behaves like graph::ShortestPathSearch.
+class ImplicitRouteSearch {
+public:
+    using Terminal = graph::ShortestPathSearch<double, RouteIndex>::Terminal;
+    using Heuristic = graph::ShortestPathSearch<double, RouteIndex>::Heuristic;
+
+    struct Ride {
+        uint32_t bus;
+        uint32_t from_index;
+        uint32_t to_index;
+    };
+
+    struct RouteInfo {
+        graph::VertexId source;
+        graph::VertexId target;
+        double weight;
+        std::vector<Ride> rides;
+    };
+
+    ImplicitRouteSearch(const std::deque<Bus>& buses, const StopCalls& calls);
+
+    // A ride takes its length over the velocity plus one bus_wait_time.
+    std::optional<RouteInfo> BuildRoute(const std::vector<Terminal>& sources, const std::vector<Terminal>& targets,
+                                        double bus_wait_time, double bus_velocity);
+
+    size_t GetSettledCount() const;
+
+    void SetHeuristic(Heuristic heuristic);
+    // A closed stop is never alighted at, but buses pass through it.
+    void CloseStop(size_t stop);
+    void SuspendBus(size_t bus);
+
+private:
+    struct StopData {
+        std::optional<double> weight;
+        std::optional<Ride> prev_ride;
+        graph::VertexId source = 0;
+        bool settled = false;
+    };
+
+    double GetQueueKey(double weight, graph::VertexId stop) const;
+
+    const std::deque<Bus>& buses_;
+    const StopCalls& calls_;
+    std::vector<StopData> stops_;
+    size_t settled_count_ = 0;
+    Heuristic heuristic_;
+    std::vector<bool> closed_stops_;
+    std::vector<bool> suspended_buses_;
+};
+
+}  // namespace transport_catalogue
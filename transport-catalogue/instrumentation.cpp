@@ -0,0 +1,147 @@
+#include "instrumentation.h"
+#include "json_builder.h"
+
+using namespace std::literals;
+
+namespace transport_catalogue {
+namespace instrumentation {
+
+void Histogram::Record(uint64_t value) {
+    ++buckets_[GetBucket(value)];
+    if (count_ == 0 || value < min_) {
+        min_ = value;
+    }
+    if (count_ == 0 || value > max_) {
+        max_ = value;
+    }
+    ++count_;
+    sum_ += value;
+}
+
+uint64_t Histogram::GetCount() const {
+    return count_;
+}
+
+uint64_t Histogram::GetMin() const {
+    return min_;
+}
+
+uint64_t Histogram::GetMax() const {
+    return max_;
+}
+
+double Histogram::GetMean() const {
+    return count_ == 0 ? 0. : static_cast<double>(sum_ / count_);
+}
+
+uint64_t Histogram::GetPercentile(double percentile) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    const auto rank = static_cast<uint64_t>(std::ceil(percentile / 100. * count_));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        seen += buckets_[bucket];
+        if (seen >= std::max<uint64_t>(rank, 1)) {
+            return std::clamp(GetBucketValue(bucket), min_, max_);
+        }
+    }
+    return max_;
+}
+
+size_t Histogram::GetBucket(uint64_t value) {
+    if (value < LINEAR_BUCKETS) {
+        return value;
+    }
+    int high_bit = 63;
+    while (!(value >> high_bit)) {
+        --high_bit;
+    }
+    const uint64_t top_bits = value >> (high_bit - 5);
+    return LINEAR_BUCKETS + (high_bit - 6) * SUB_BUCKETS + (top_bits - SUB_BUCKETS);
+}
+
+uint64_t Histogram::GetBucketValue(size_t bucket) {
+    if (bucket < LINEAR_BUCKETS) {
+        return bucket;
+    }
+    const size_t high_bit = (bucket - LINEAR_BUCKETS) / SUB_BUCKETS + 6;
+    const uint64_t top_bits = (bucket - LINEAR_BUCKETS) % SUB_BUCKETS + SUB_BUCKETS;
+    const uint64_t width = uint64_t{1} << (high_bit - 5);
+    return (top_bits << (high_bit - 5)) + width / 2;
+}
+
+Registry& Registry::Instance() {
+    static Registry registry;
+    return registry;
+}
+
+void Registry::Enable() {
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Registry::Reset() {
+    std::lock_guard guard(mutex_);
+    counters_.clear();
+    timers_.clear();
+}
+
+void Registry::AddCounter(std::string_view name, int64_t delta) {
+    std::lock_guard guard(mutex_);
+    auto it = counters_.find(name);
+    if (it == counters_.end()) {
+        it = counters_.emplace(std::string{name}, 0).first;
+    }
+    it->second += delta;
+}
+
+void Registry::RecordTime(std::string_view name, std::chrono::nanoseconds duration) {
+    std::lock_guard guard(mutex_);
+    auto it = timers_.find(name);
+    if (it == timers_.end()) {
+        it = timers_.emplace(std::string{name}, Histogram{}).first;
+    }
+    it->second.Record(static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0)));
+}
+
+json::Node Registry::GetReport(std::string_view stage) const {
+    std::lock_guard guard(mutex_);
+    json::Dict counters;
+    for (const auto& [name, value] : counters_) {
+        counters.emplace(name, static_cast<double>(value));
+    }
+    json::Dict timers;
+    for (const auto& [name, histogram] : timers_) {
+        // Durations are recorded in nanoseconds and reported in microseconds.
+        auto us = [](double nanoseconds) {
+            return nanoseconds / 1000.;
+        };
+        timers.emplace(name, json::Builder{}.StartDict()
+                                 .Key("count"s).Value(static_cast<double>(histogram.GetCount()))
+                                 .Key("total_us"s).Value(us(histogram.GetMean() * histogram.GetCount()))
+                                 .Key("mean_us"s).Value(us(histogram.GetMean()))
+                                 .Key("min_us"s).Value(us(histogram.GetMin()))
+                                 .Key("p50_us"s).Value(us(histogram.GetPercentile(50)))
+                                 .Key("p90_us"s).Value(us(histogram.GetPercentile(90)))
+                                 .Key("p99_us"s).Value(us(histogram.GetPercentile(99)))
+                                 .Key("p999_us"s).Value(us(histogram.GetPercentile(99.9)))
+                                 .Key("max_us"s).Value(us(histogram.GetMax()))
+                             .EndDict().Build());
+    }
+    return json::Builder{}.StartDict()
+                              .Key("stage"s).Value(std::string{stage})
+                              .Key("counters"s).Value(std::move(counters))
+                              .Key("timers"s).Value(std::move(timers))
+                          .EndDict().Build();
+}
+
+void Registry::WriteReport(std::string_view stage, const InstrumentationSettings& settings) const {
+    if (!IsEnabled() || settings.path.empty()) {
+        return;
+    }
+    std::ofstream out(settings.path);
+    json::Print(json::Document{GetReport(stage)}, out);
+}
+
+} // namespace instrumentation
+} // namespace transport_catalogue
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "json.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+namespace transport_catalogue {
+namespace instrumentation {
+
+struct InstrumentationSettings {
+    std::filesystem::path path;
+};
+
+// Log-linear latency histogram in the spirit of HdrHistogram: exact below 64 ns,
+// then 32 buckets per power of two, i.e. about 3% relative precision.
+class Histogram {
+public:
+    void Record(uint64_t value);
+    uint64_t GetCount() const;
+    uint64_t GetMin() const;
+    uint64_t GetMax() const;
+    double GetMean() const;
+    uint64_t GetPercentile(double percentile) const;
+
+private:
+    static constexpr size_t LINEAR_BUCKETS = 64;
+    static constexpr size_t SUB_BUCKETS = 32;
+    static constexpr size_t BUCKET_COUNT = LINEAR_BUCKETS + (64 - 6) * SUB_BUCKETS;
+
+    static size_t GetBucket(uint64_t value);
+    static uint64_t GetBucketValue(size_t bucket);
+
+    std::array<uint64_t, BUCKET_COUNT> buckets_{};
+    uint64_t count_ = 0;
+    uint64_t min_ = 0;
+    uint64_t max_ = 0;
+    long double sum_ = 0;
+};
+
+// Process-wide store of counters and timer histograms. Everything is a no-op
+// until Enable() is called, so probes on hot paths cost a relaxed load.
+class Registry {
+public:
+    static Registry& Instance();
+
+    void Enable();
+    void Reset();
+    bool IsEnabled() const {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    void AddCounter(std::string_view name, int64_t delta = 1);
+    void RecordTime(std::string_view name, std::chrono::nanoseconds duration);
+    json::Node GetReport(std::string_view stage) const;
+    void WriteReport(std::string_view stage, const InstrumentationSettings& settings) const;
+
+private:
+    std::atomic<bool> enabled_ = false;
+    mutable std::mutex mutex_;
+    std::map<std::string, int64_t, std::less<>> counters_;
+    std::map<std::string, Histogram, std::less<>> timers_;
+};
+
+inline bool IsEnabled() {
+    return Registry::Instance().IsEnabled();
+}
+
+inline void AddCounter(std::string_view name, int64_t delta = 1) {
+    if (IsEnabled()) {
+        Registry::Instance().AddCounter(name, delta);
+    }
+}
+
+// Records the lifetime of the object into the timer histogram called name.
+// The name must outlive the timer.
+class ScopedTimer {
+public:
+    explicit ScopedTimer(std::string_view name)
+        : name_(name)
+        , active_(IsEnabled()) {
+        if (active_) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    ~ScopedTimer() {
+        if (active_) {
+            Registry::Instance().RecordTime(name_, std::chrono::steady_clock::now() - start_);
+        }
+    }
+
+private:
+    std::string_view name_;
+    bool active_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace instrumentation
+} // namespace transport_catalogue
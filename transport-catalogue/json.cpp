@@ -1,4 +1,7 @@
 #include "json.h"
+
+#include <array>
+#include <charconv>
  
 using namespace std;
 using namespace std::literals;
@@ -9,205 +12,360 @@ namespace json {
 namespace {
 using namespace std::literals;
 
-Node LoadNode(istream& input);
-Node LoadString(std::istream& input);
+// Reads straight from the stream buffer instead of going through the
+// formatted istream calls, one sentry per character adds up on large bases.
+// Exactly one value is consumed and the stream is left right after it, so
+// line-oriented callers can keep reading.
+class Parser {
+public:
+    explicit Parser(std::istream& input) : buffer_(*input.rdbuf()) {
+    }
 
-std::string LoadLiteral(std::istream& input) {
-    std::string s;
-    while (std::isalpha(input.peek())) {
-        s.push_back(static_cast<char>(input.get()));
+    Node LoadNode() {
+        switch (PeekToken()) {
+            case END : throw ParsingError("Unexpected EOF"s);
+            case '[' : Get();
+                       return LoadArray();
+            case '{' : Get();
+                       return LoadDict();
+            case '"' : Get();
+                       return Node(LoadString());
+            case 't' : [[fallthrough]];
+            case 'f' : return LoadBool();
+            case 'n' : return LoadNull();
+            default : return LoadNumber();
+        }
+    }
+
+private:
+    static constexpr int END = std::char_traits<char>::eof();
+
+    // Plain ASCII checks: the <cctype> ones go through the locale on every call.
+    static bool IsSpace(int c) {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+    }
+
+    static bool IsDigit(int c) {
+        return c >= '0' && c <= '9';
+    }
+
+    static bool IsAlpha(int c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    int Peek() {
+        return buffer_.sgetc();
+    }
+
+    int Get() {
+        return buffer_.sbumpc();
+    }
+
+    // Skips whitespace and returns the next character without consuming it.
+    int PeekToken() {
+        int c = Peek();
+        while (IsSpace(c)) {
+            Get();
+            c = Peek();
+        }
+        return c;
     }
-    return s;
-}
-    
-Node LoadNull(std::istream& input) {
-    if (auto literal = LoadLiteral(input); literal == "null"sv) {
-        return Node{ nullptr };
-    } else {
-          throw ParsingError("Failed to parse '"s + literal + "' as null"s);
-      }
-}
 
-Node LoadNumber(std::istream& input) {
-    std::string parsed_num;
-    auto read_char = [&parsed_num, &input] {
-        parsed_num += static_cast<char>(input.get());
-        if (!input) {
-            throw ParsingError("Failed to read number"s);
+    std::string LoadLiteral() {
+        std::string s;
+        while (IsAlpha(Peek())) {
+            s.push_back(static_cast<char>(Get()));
         }
-    };
-    auto read_digits = [&input, read_char] {
-        if (!std::isdigit(input.peek())) {
-            throw ParsingError("A digit is expected"s);
+        return s;
+    }
+
+    Node LoadNull() {
+        if (auto literal = LoadLiteral(); literal == "null"sv) {
+            return Node{ nullptr };
+        } else {
+              throw ParsingError("Failed to parse '"s + literal + "' as null"s);
+          }
+    }
+
+    Node LoadBool() {
+        const auto s = LoadLiteral();
+        if (s == "true"sv) {
+            return Node{ true };
+        } else if (s == "false"sv) {
+              return Node{ false };
+          } else {
+                throw ParsingError("Failed to parse '"s + s + "' as bool"s);
+            }
+    }
+
+    Node LoadNumber() {
+        std::string parsed_num;
+        auto read_char = [this, &parsed_num] {
+            const int c = Get();
+            if (c == END) {
+                throw ParsingError("Failed to read number"s);
+            }
+            parsed_num += static_cast<char>(c);
+        };
+        auto read_digits = [this, read_char] {
+            if (!IsDigit(Peek())) {
+                throw ParsingError("A digit is expected"s);
+            }
+            while (IsDigit(Peek())) {
+                read_char();
+            }
+        };
+        if (Peek() == '-') {
+            read_char();
         }
-        while (std::isdigit(input.peek())) {
+        if (Peek() == '0') {
+            read_char();
+        } else {
+              read_digits();
+          }
+        bool is_int = true;
+        if (Peek() == '.') {
             read_char();
+            read_digits();
+            is_int = false;
         }
-    };
-    if (input.peek() == '-') {
-        read_char();
-    }
-    if (input.peek() == '0') {
-        read_char();
-    } else {
-          read_digits();
-      }
-    bool is_int = true;
-    if (input.peek() == '.') {
-        read_char();
-        read_digits();
-        is_int = false;
-    }
-    if (int ch = input.peek(); ch == 'e' || ch == 'E') {
-        read_char();
-        if (ch = input.peek(); ch == '+' || ch == '-') {
+        if (int ch = Peek(); ch == 'e' || ch == 'E') {
             read_char();
+            if (ch = Peek(); ch == '+' || ch == '-') {
+                read_char();
+            }
+            read_digits();
+            is_int = false;
         }
-        read_digits();
-        is_int = false;
-    }
-    try { 
+        const char* first = parsed_num.data();
+        const char* last = first + parsed_num.size();
         if (is_int) {
-            try {
-                return std::stoi(parsed_num);
-            }
-            catch (...) {
+            int value = 0;
+            if (const auto [ptr, error] = std::from_chars(first, last, value); error == std::errc{} && ptr == last) {
+                return value;
             }
         }
-        return std::stod(parsed_num);
-    }
-    catch (...) {
+        double value = 0;
+        if (const auto [ptr, error] = std::from_chars(first, last, value); error == std::errc{} && ptr == last) {
+            return value;
+        }
         throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
     }
-}
 
-Node LoadBool(std::istream& input) {
-    const auto s = LoadLiteral(input);
-    if (s == "true"sv) {
-        return Node{ true };
+    std::string LoadString() {
+        std::string s;
+        while (true) {
+            const int ch = Get();
+            if (ch == END) {
+                throw ParsingError("String parsing error");
+            }
+            if (ch == '"') {
+                break;
+            } else if (ch == '\\') {
+                  const int escaped_char = Get();
+                  switch (escaped_char) {
+                      case END:
+                      throw ParsingError("String parsing error");
+                      case 'n':
+                      s.push_back('\n');
+                      break;
+                      case 't':
+                      s.push_back('\t');
+                      break;
+                      case 'r':
+                      s.push_back('\r');
+                      break;
+                      case '"':
+                      s.push_back('"');
+                      break;
+                      case '\\':
+                      s.push_back('\\');
+                      break;
+                      default:
+                      throw ParsingError("Unrecognized escape sequence \\"s + static_cast<char>(escaped_char));
+                  }
+              } else if (ch == '\n' || ch == '\r') {
+                    throw ParsingError("Unexpected end of line"s);
+                } else {
+                      s.push_back(static_cast<char>(ch));
+                  }
+        }
+        return s;
     }
-    else if (s == "false"sv) {
-                return Node{ false };
-    } else {
-          throw ParsingError("Failed to parse '"s + s + "' as bool"s);
-      }
-}
 
-Node LoadString(std::istream& input) {
-    auto it = std::istreambuf_iterator<char>(input);
-    auto end = std::istreambuf_iterator<char>();
-    std::string s;
-    while (true) {
-        if (it == end) {
-            throw ParsingError("String parsing error");
+    Node LoadArray() {
+        const size_t first = array_stack_.size();
+        while (true) {
+            const int c = PeekToken();
+            if (c == END) {
+                throw ParsingError("Array parsing error"s);
+            }
+            if (c == ']') {
+                Get();
+                break;
+            }
+            if (c == ',') {
+                Get();
+                continue;
+            }
+            Node element = LoadNode();
+            array_stack_.push_back(std::move(element));
         }
-        const char ch = *it;
-        if (ch == '"') {
-            ++it;
-            break;
-        } else if (ch == '\\') {
-              ++it;
-              if (it == end) {
-                  throw ParsingError("String parsing error");
-              }
-              const char escaped_char = *(it);
-              switch (escaped_char) {
-                  case 'n':
-                  s.push_back('\n');
-                  break;
-                  case 't':
-                  s.push_back('\t');
-                  break;
-                  case 'r':
-                  s.push_back('\r');
-                  break;
-                  case '"':
-                  s.push_back('"');
-                  break;
-                  case '\\':
-                  s.push_back('\\');
-                  break;
-                  default:
-                  throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
-              }
-          } else if (ch == '\n' || ch == '\r') {
-                throw ParsingError("Unexpected end of line"s);
-            } else {
-                  s.push_back(ch);
+        Array result(std::make_move_iterator(array_stack_.begin() + first), std::make_move_iterator(array_stack_.end()));
+        array_stack_.resize(first);
+        return Node(std::move(result));
+    }
+
+    // Fields are collected unsorted and sorted once at the end.
+    Node LoadDict() {
+        const size_t first = dict_stack_.size();
+        while (true) {
+            const int c = Get();
+            if (IsSpace(c)) {
+                continue;
+            }
+            if (c == END) {
+                throw ParsingError("Dictionary parsing error"s);
+            }
+            if (c == '}') {
+                break;
+            }
+            if (c == '"') {
+                std::string key = LoadString();
+                if (const int colon = PeekToken(); colon == ':') {
+                    Get();
+                    Node value = LoadNode();
+                    dict_stack_.emplace_back(std::move(key), std::move(value));
+                } else {
+                      throw ParsingError(": is expected but '"s + static_cast<char>(colon) + "' has been found"s);
+                  }
+            } else if (c != ',') {
+                  throw ParsingError(R"(',' is expected but ')"s + static_cast<char>(c) + "' has been found"s);
               }
-              ++it;
+        }
+        std::vector<Dict::value_type> items(std::make_move_iterator(dict_stack_.begin() + first), std::make_move_iterator(dict_stack_.end()));
+        dict_stack_.resize(first);
+        const size_t field_count = items.size();
+        Dict dict(std::move(items));
+        if (dict.size() != field_count) {
+            throw ParsingError("Duplicate key has been found"s);
+        }
+        return Node(std::move(dict));
     }
-    return Node(std::move(s));
+
+    std::streambuf& buffer_;
+    // Elements of the arrays and objects still being parsed, innermost last.
+    // Each container is copied out once with its exact size when it closes.
+    Array array_stack_;
+    std::vector<Dict::value_type> dict_stack_;
+};
+
+// The character written after a backslash for c, or 0 if c is written as is.
+constexpr std::array<char, 256> MakeEscapes() {
+    std::array<char, 256> escapes{};
+    escapes['\r'] = 'r';
+    escapes['\n'] = 'n';
+    escapes['"'] = '"';
+    escapes['\\'] = '\\';
+    return escapes;
 }
 
-Node LoadArray(std::istream& input) {
-    std::vector<Node> result;
-    for (char c; input >> c && c != ']';) {
-        if (c != ',') {
-            input.putback(c);
-        }
-        result.push_back(LoadNode(input));
+constexpr std::array<char, 256> ESCAPES = MakeEscapes();
+
+// Collects the output in a char buffer and hands it to the stream in large
+// chunks, so the per-call cost of the formatted ostream operations is paid
+// once per chunk instead of once per token.
+class Writer {
+public:
+    explicit Writer(std::ostream& out) : out_(out) {
+        buffer_.reserve(CHUNK_SIZE + MAX_TOKEN_SIZE);
     }
-    if (!input) {
-        throw ParsingError("Array parsing error"s);
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    ~Writer() {
+        Flush();
     }
-    return Node(std::move(result));
-}
 
-Node LoadDict(istream& input) {
-    Dict dict;
-    for (char c; input >> c && c != '}';) {
-        if (c == '"') {
-            std::string key = LoadString(input).AsString();
-            if (input >> c && c == ':') {
-                if (dict.find(key) != dict.end()) {
-                    throw ParsingError("Duplicate key '"s + key + "' have been found");
-                }
-                dict.emplace(std::move(key), LoadNode(input));
-            } else {
-                  throw ParsingError(": is expected but '"s + c + "' has been found"s);
-              }
-        }
-        else if (c != ',') {
-            throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+    void Put(char c) {
+        buffer_.push_back(c);
+        FlushIfFull();
+    }
+
+    void Write(std::string_view text) {
+        buffer_.append(text);
+        FlushIfFull();
+    }
+
+    void WriteSpaces(int count) {
+        buffer_.append(static_cast<size_t>(count), ' ');
+        FlushIfFull();
+    }
+
+    template <typename Number>
+    void WriteNumber(Number value) {
+        char digits[MAX_TOKEN_SIZE];
+        // Shortest representation that reads back to the same value.
+        const auto [end, error] = std::to_chars(std::begin(digits), std::end(digits), value);
+        buffer_.append(digits, end);
+        FlushIfFull();
+    }
+
+    // Copies the runs between characters that need escaping in one go.
+    void WriteEscaped(std::string_view text) {
+        buffer_.push_back('"');
+        size_t run_begin = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            const char escaped = ESCAPES[static_cast<unsigned char>(text[i])];
+            if (escaped == 0) {
+                continue;
+            }
+            buffer_.append(text.data() + run_begin, i - run_begin);
+            buffer_.push_back('\\');
+            buffer_.push_back(escaped);
+            run_begin = i + 1;
+            FlushIfFull();
         }
+        buffer_.append(text.data() + run_begin, text.size() - run_begin);
+        buffer_.push_back('"');
+        FlushIfFull();
     }
-    if (!input) {
-        throw ParsingError("Dictionary parsing error"s);
+
+    void Flush() {
+        out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
     }
-    return Node(std::move(dict));
-}
 
-Node LoadNode(istream& input) {
-    char c;
-    if (!(input >> c)) {
-        throw ParsingError("Unexpected EOF"s);
-    }
-    switch (c) {
-        case '[' : return LoadArray(input);
-        case '{' : return LoadDict(input);
-        case '"' : return LoadString(input);
-        case 't' : [[fallthrough]];
-        case 'f' : input.putback(c);
-                   return LoadBool(input);
-        case 'n' : input.putback(c);
-                   return LoadNull(input);
-        default : input.putback(c);
-                  return LoadNumber(input);
-    }
-}  
+private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+    static constexpr size_t MAX_TOKEN_SIZE = 64;
+
+    void FlushIfFull() {
+        if (buffer_.size() >= CHUNK_SIZE) {
+            Flush();
+        }
+    }
+
+    std::ostream& out_;
+    std::string buffer_;
+};
 
 struct PrintContext {
-    std::ostream& out;
+    Writer& out;
     int indention = 4;
     int indention_ = 0;
+    bool compact = false;
     void PrintIndent() const {
-        for (int i = 0; i < indention_; ++i) {
-            out.put(' ');
+        out.WriteSpaces(indention_);
+    }
+    void PrintLineBreak() const {
+        if (!compact) {
+            out.Put('\n');
         }
     }
     PrintContext Indented() const {
-        return { out, indention, indention + indention_ };
+        return { out, indention, indention + indention_, compact };
     }
 };
     
@@ -215,82 +373,68 @@ void PrintNode(const Node& value, const PrintContext& context);
 
 template <typename Value>
 void PrintValue(const Value& value, const PrintContext& context) {
-    context.out << value;
-}
-
-void PrintString(const std::string& value, std::ostream& out) {
-    out.put('"');
-    for (const char c : value) {
-        switch (c) {
-            case '\r' : out << "\\r"sv;
-            break;
-            case '\n' : out << "\\n"sv;
-            break;
-            case '"' : [[fallthrough]];
-            case '\\' : out.put('\\');
-                        [[fallthrough]];
-            default : out.put(c);
-                      break;
-        }
-    }
-    out.put('"');
+    context.out.WriteNumber(value);
 }
 
 template <>
 void PrintValue<std::string>(const std::string& value, const PrintContext& context) {
-    PrintString(value, context.out);
+    context.out.WriteEscaped(value);
 }
 
 template <>
 void PrintValue<std::nullptr_t>(const std::nullptr_t&, const PrintContext& context) {
-    context.out << "null"sv;
+    context.out.Write("null"sv);
 }
 
 template <>
 void PrintValue<bool>(const bool& value, const PrintContext& context) {
-    context.out << (value ? "true"sv : "false"sv);
+    context.out.Write(value ? "true"sv : "false"sv);
 }
 
 template <>
 void PrintValue<Array>(const Array& nodes, const PrintContext& context) {
-    std::ostream& out = context.out;
-    out << "[\n"sv;
+    Writer& out = context.out;
+    out.Put('[');
+    context.PrintLineBreak();
     bool first = true;
     auto inner_context = context.Indented();
     for (const Node& node : nodes) {
         if (first) {
             first = false;
         } else {
-              out << ",\n"sv;
+              out.Put(',');
+              context.PrintLineBreak();
           }
           inner_context.PrintIndent();
           PrintNode(node, inner_context);
     }
-    out.put('\n');
+    context.PrintLineBreak();
     context.PrintIndent();
-    out.put(']');
+    out.Put(']');
 }
 
 template <>
 void PrintValue<Dict>(const Dict& nodes, const PrintContext& context) {
-    std::ostream& out = context.out;
-    out << "{\n"sv;
+    Writer& out = context.out;
+    out.Put('{');
+    context.PrintLineBreak();
     bool first = true;
     auto inner_context = context.Indented();
     for (const auto& [key, node] : nodes) {
         if (first) {
             first = false;
         } else {
-              out << ",\n"sv;
+              out.Put(',');
+              context.PrintLineBreak();
           }
           inner_context.PrintIndent();
-          PrintString(key, context.out);
-          out << ": "sv;
+          out.WriteEscaped(key);
+          out.Write(context.compact ? ":"sv : ": "sv);
           PrintNode(node, inner_context);
     }
-    out.put('\n');
+    context.PrintLineBreak();
     context.PrintIndent();
-    out.put('}');
+    out.Put('}');
 }
 
 void PrintNode(const Node& node, const PrintContext& ctx) {
@@ -388,11 +532,17 @@ Node::Value& Node::GetNoConstValue() {
 }
 
 Document Load(istream& input) {
-    return Document{ LoadNode(input) };
+    return Document{ Parser(input).LoadNode() };
 }
 
 void Print(const Document& doc, std::ostream& output) {
-    PrintNode(doc.GetRoot(), PrintContext{ output });
+    Writer writer(output);
+    PrintNode(doc.GetRoot(), PrintContext{ writer });
+}
+
+void PrintCompact(const Document& doc, std::ostream& output) {
+    Writer writer(output);
+    PrintNode(doc.GetRoot(), PrintContext{ writer, 0, 0, true });
 }
  
 }//end namespace json
@@ -1,5 +1,6 @@
 #pragma once
 #include "transport_catalogue.h"
+#include "flat_map.h"
 
 namespace transport_catalogue {
 namespace json {
@@ -7,7 +8,7 @@ namespace json {
 using namespace std::literals;
 
 class Node;
-using Dict = std::map<std::string, Node>;
+using Dict = FlatMap<Node>;
 using Array = std::vector<Node>;
 
 class ParsingError : public std::runtime_error {
@@ -69,6 +70,8 @@ inline bool operator!=(const Document& lhs, const Document& rhs) {
 Document Load(std::istream& input);
     
 void Print(const Document& doc, std::ostream& output);
+// Same output on a single line, e.g. for newline-delimited streams.
+void PrintCompact(const Document& doc, std::ostream& output);
  
 }// end namespace json
 }// end namespace transport_catalogue
@@ -2,20 +2,51 @@
 #include "json_builder.h"
 #include "graph.h"
 
+#include <stdexcept>
+
 using namespace std::literals;
 
 namespace transport_catalogue {
 
 void JSONReader::ReadSerializationSettings(const json::Node &node) {
-    serializator_settings_.path = node.AsMap().at("file"s).AsString();
+    const json::Dict& settings = node.AsMap();
+    serializator_settings_.path = settings.at("file"s).AsString();
+    if (const auto order_i = settings.find("stop_order"s); order_i != settings.end()) {
+        if (order_i->second == "hilbert"s) {
+            serializator_settings_.stop_order = serializator::StopOrder::HILBERT;
+        } else if (order_i->second == "input"s) {
+              serializator_settings_.stop_order = serializator::StopOrder::INPUT;
+          } else {
+                throw json::ParsingError("Invalid field in request' node");
+            }
+    }
 }
 
-void JSONReader::OutputInfo(std::ostream& out){
-    json::Array output_array;
-    for (json::Node element : request_to_output_){
-        output_array.push_back(element);
+void JSONReader::ReadInstrumentationSettings(const json::Node &node) {
+    instrumentation_settings_.path = node.AsMap().at("file"s).AsString();
+    instrumentation::Registry::Instance().Enable();
+}
+
+void JSONReader::ReadServerSettings(const json::Node &node) {
+    const json::Dict& settings = node.AsMap();
+    if (const auto socket_i = settings.find("socket"s); socket_i != settings.end()) {
+        server_settings_.socket_path = socket_i->second.AsString();
     }
-    json::Print (json::Document { json::Builder{}.Value(output_array).Build() }, out);
+    if (const auto threads_i = settings.find("threads"s); threads_i != settings.end()) {
+        server_settings_.threads = static_cast<size_t>(std::max(threads_i->second.AsInt(), 1));
+    }
+}
+
+json::Array JSONReader::TakeOutput() {
+    json::Array output_array = std::move(request_to_output_);
+    request_to_output_.clear();
+    return output_array;
+}
+
+void JSONReader::OutputInfo(std::ostream& out){
+    instrumentation::ScopedTimer timer("json.print"sv);
+    json::Print (json::Document { json::Builder{}.Value(std::move(request_to_output_)).Build() }, out);
+    request_to_output_.clear();
 }
     
 void JSONReader::MakeBase(std::istream& input){
@@ -24,18 +55,33 @@ void JSONReader::MakeBase(std::istream& input){
 }
 
 void JSONReader::ReadRawJson(std::istream& input, std::vector<json::Document>& document) {
+    // The settings that switch instrumentation on live inside the document being
+    // timed, so the load is measured unconditionally and recorded afterwards.
+    const auto load_start = std::chrono::steady_clock::now();
     json::Document doc = json::Load(input);
+    const auto load_time = std::chrono::steady_clock::now() - load_start;
     if (doc.GetRoot().IsMap()) {
+        const json::Dict& root = doc.GetRoot().AsMap();
+        if (const auto settings_i = root.find("instrumentation_settings"s); settings_i != root.end()) {
+            ReadInstrumentationSettings(settings_i->second);
+        }
+        if (instrumentation::IsEnabled()) {
+            instrumentation::Registry::Instance().RecordTime("json.load"sv, load_time);
+        }
         document.emplace_back(std::move(doc));
     }
 }
 
 void JSONReader::ParseBase() {
     for (auto& doc : base_document_){
-        json::Node raw_map = doc.GetRoot();
+        const json::Node& raw_map = doc.GetRoot();
         if (!raw_map.IsMap()){
             throw json::ParsingError("Incorrect input data type");
         }
+        // The stop order is needed before the stops are added.
+        if (const auto settings_i = raw_map.AsMap().find("serialization_settings"s); settings_i != raw_map.AsMap().end()) {
+            ReadSerializationSettings(settings_i->second);
+        }
         for(const auto& [key, value] : raw_map.AsMap()){
             if (key == "base_requests"){
                 AddToCatalog(raw_map.AsMap().at(key));
@@ -43,9 +89,7 @@ void JSONReader::ParseBase() {
                   ReadRenderSettings(raw_map.AsMap().at(key));
               } else if (key == "routing_settings") {
                     AddRoutingSettings(raw_map.AsMap().at(key));
-                } else if (key == "serialization_settings") {
-                      ReadSerializationSettings(raw_map.AsMap().at(key));
-                  }
+                }
             }
         }
 }
@@ -57,7 +101,7 @@ void JSONReader::Request(std::istream& input) {
 
 void JSONReader::ParseStatRequest() {
     for (auto& doc : request_document_){
-        json::Node raw_map = doc.GetRoot();
+        const json::Node& raw_map = doc.GetRoot();
         if (!raw_map.IsMap()){
             throw json::ParsingError("Incorrect input data type");
         }
@@ -71,145 +115,298 @@ void JSONReader::ParseStatRequest() {
     
 void JSONReader::ParseSerializeSettings() {
     for (auto& doc : request_document_){
-        json::Node raw_map = doc.GetRoot();
+        const json::Node& raw_map = doc.GetRoot();
         if (!raw_map.IsMap()){
             throw json::ParsingError("Incorrect input data type");
         }
         for(const auto& [key, value] : raw_map.AsMap()){
             if (key == "serialization_settings"){
                 ReadSerializationSettings(raw_map.AsMap().at(key));
-            }
+            } else if (key == "server_settings") {
+                  ReadServerSettings(raw_map.AsMap().at(key));
+              }
         }
     }
 }
     
 void JSONReader::AddRoutingSettings(const json::Node &root) {
-    for (auto [key, value] : root.AsMap()){
+    RoutingSettings& settings = GetBaseRouter().settings_;
+    for (const auto& [key, value] : root.AsMap()){
         if (key == "bus_wait_time"){
-            router_.settings_.bus_wait_time_ = value.AsDouble();
+            settings.bus_wait_time_ = value.AsDouble();
         } else if (key == "bus_velocity"){
-              router_.settings_.bus_velocity_ = value.AsDouble();
-          }
+              settings.bus_velocity_ = value.AsDouble();
+          } else if (key == "walking_velocity") {
+                settings.walking_velocity_ = value.AsDouble();
+            } else if (key == "max_walking_distance") {
+                  settings.max_walking_distance_ = value.AsDouble();
+              } else if (key == "walking_stop_count") {
+                    settings.walking_stop_count_ = value.AsInt();
+                } else if (key == "max_transfers") {
+                      settings.max_transfers_ = value.AsInt();
+                  } else if (key == "pareto_label_limit") {
+                        settings.pareto_label_limit_ = value.AsInt();
+                    } else if (key == "alternative_work_limit") {
+                          settings.alternative_work_limit_ = value.AsInt();
+                      } else if (key == "goal_directed_search") {
+                            settings.goal_directed_search_ = value.AsBool();
+                        } else if (key == "implicit_edges") {
+                              settings.implicit_edges_ = value.AsBool();
+                          } else if (key == "memory_budget_mb") {
+                                settings.memory_budget_mb_ = value.AsDouble();
+                            }
     }
 }
     
-void JSONReader::AddStop(const json::Array& arr) {
-    for (auto& element : arr){
-        const json::Dict& dict = element.AsMap();
-        const auto type_i = dict.find("type"s);
-        if (type_i == dict.end()) {
-            continue;
-        }
-        if (type_i->second == "Stop"s) {
-            Stop stop;
-            std::vector<std::pair<std::string, double>> id_;
-            if (const auto name_i = dict.find("name"s); name_i != dict.end() && name_i->second.IsString()) {
-                stop.name = name_i->second.AsString();
-            } else {
-                  continue;
-              }
-            if (const auto lat_i = dict.find("latitude"s); lat_i != dict.end() && lat_i->second.IsDouble()) {
-                stop.coord.lat = lat_i->second.AsDouble();
-            } else {
-                  continue;
-              }
-            if (const auto lng_i = dict.find("longitude"s); lng_i != dict.end() && lng_i->second.IsDouble()) {
-                stop.coord.lng = lng_i->second.AsDouble();
-            } else {
-                  continue;
-              }
-            const auto dist_i = dict.find("road_distances"s);
-            if (dist_i != dict.end() && !(dist_i->second.IsMap())) {
+std::optional<QueryInputStop> JSONReader::ReadBaseStop(const json::Dict& dict) const {
+    QueryInputStop stop;
+    if (const auto name_i = dict.find("name"s); name_i != dict.end() && name_i->second.IsString()) {
+        stop.name = name_i->second.AsString();
+    } else {
+          return std::nullopt;
+      }
+    if (const auto lat_i = dict.find("latitude"s); lat_i != dict.end() && lat_i->second.IsDouble()) {
+        stop.coord.lat = lat_i->second.AsDouble();
+    } else {
+          return std::nullopt;
+      }
+    if (const auto lng_i = dict.find("longitude"s); lng_i != dict.end() && lng_i->second.IsDouble()) {
+        stop.coord.lng = lng_i->second.AsDouble();
+    } else {
+          return std::nullopt;
+      }
+    const auto dist_i = dict.find("road_distances"s);
+    if (dist_i != dict.end() && !(dist_i->second.IsMap())) {
+        return std::nullopt;
+    }
+    if (dist_i != dict.end()) {
+        for (const auto& [other_name, other_dist] : dist_i->second.AsMap()) {
+            if (!other_dist.IsInt()) {
                 continue;
             }
-            for (const auto& [other_name, other_dist] : dist_i->second.AsMap()) {
-                if (!other_dist.IsInt()) {
-                    continue; 
-                }
-                id_.push_back({other_name, static_cast<size_t>(other_dist.AsInt())});
-            }
-            transport_catalogue_.AddStop(stop.name, stop.coord.lat, 
-            stop.coord.lng, id_);
+            stop.distances.push_back({other_name, static_cast<size_t>(other_dist.AsInt())});
         }
     }
+    return stop;
 }
-    
-void JSONReader::AddBus(const json::Array& arr) {
-    for (auto& element : arr) {
-        const json::Dict& dict = element.AsMap();
-        const auto type_i = dict.find("type"s);
-        if (type_i == dict.end()) {
+
+std::optional<QueryInputBus> JSONReader::ReadBaseBus(const json::Dict& dict) const {
+    QueryInputBus bus;
+    if (const auto name_i = dict.find("name"s); name_i != dict.end() && name_i->second.IsString()) {
+        bus.name = name_i->second.AsString();
+    } else {
+          return std::nullopt;
+      }
+    if (const auto route_i = dict.find("is_roundtrip"s); route_i != dict.end() && route_i->second.IsBool()) {
+        bus.type = route_i->second.AsBool() ? RouteType::CIRCLE : RouteType::TWO_DIRECTIONAL;
+    } else {
+          return std::nullopt;
+      }
+    const auto stops_i = dict.find("stops"s);
+    if (stops_i == dict.end() || !(stops_i->second.IsArray())) {
+        return std::nullopt;
+    }
+    for (const auto& stop_name : stops_i->second.AsArray()) {
+        if (!stop_name.IsString()) {
             continue;
         }
-        if (type_i->second == "Bus"s) {
-            QueryInputBus bus;
-            if (const auto name_i = dict.find("name"s); name_i != dict.end() && name_i->second.IsString()) {
-                bus.name = name_i->second.AsString();
-            } else {
-                  continue;
-              }
-            if (const auto route_i = dict.find("is_roundtrip"s); route_i != dict.end() && route_i->second.IsBool()) {
-                bus.type = route_i->second.AsBool() ? RouteType::CIRCLE : RouteType::TWO_DIRECTIONAL;
-            } else{
-                  continue;
-              }
-            const auto stops_i = dict.find("stops"s);
-            if (stops_i != dict.end() && !(stops_i->second.IsArray())) {
-                continue;
+        bus.stops_list.emplace_back(stop_name.AsString());
+    }
+    if (const auto trips_i = dict.find("trips"s); trips_i != dict.end()) {
+        // Times are given for the whole run, i.e. there and back for a non-roundtrip bus.
+        const size_t stop_count = bus.type == RouteType::CIRCLE ? bus.stops_list.size() : std::max<size_t>(bus.stops_list.size() * 2, 1) - 1;
+        if (!trips_i->second.IsArray()) {
+            throw json::ParsingError("Trips of bus "s + bus.name + " are not an array"s);
+        }
+        for (const auto& trip_node : trips_i->second.AsArray()) {
+            if (!trip_node.IsArray() || trip_node.AsArray().size() != stop_count) {
+                throw json::ParsingError("Every trip of bus "s + bus.name + " needs "s + std::to_string(stop_count) + " stop times"s);
             }
-            for (const auto& stop_name : stops_i->second.AsArray()) {
-                if (!stop_name.IsString()) {
-                    continue;
+            Trip trip;
+            trip.reserve(stop_count);
+            for (const auto& time : trip_node.AsArray()) {
+                if (!time.IsDouble() || (!trip.empty() && time.AsDouble() < trip.back())) {
+                    throw json::ParsingError("Stop times of bus "s + bus.name + " must be non-decreasing numbers"s);
                 }
-                bus.stops_list.emplace_back(stop_name.AsString());
+                trip.push_back(time.AsDouble());
             }
-            transport_catalogue_.AddBus(bus);
-        } else {
+            bus.trips.push_back(std::move(trip));
+        }
+    }
+    return bus;
+}
+
+// Stop ids follow the order in which stops are first mentioned, so the
+// registration itself stays sequential. With the Hilbert stop order the stops
+// are registered along the curve first, and the second pass only adds the
+// distances, so neighbouring stops get neighbouring ids in the catalogue, the
+// graph and the base file alike. Stops known only from road_distances still
+// get the last ids.
+void JSONReader::AddStop(const std::vector<std::optional<QueryInputStop>>& stops) {
+    instrumentation::ScopedTimer timer("catalogue.add_stops"sv);
+    TransportCatalogue& catalogue = GetBaseCatalogue();
+    if (serializator_settings_.stop_order == serializator::StopOrder::HILBERT) {
+        instrumentation::ScopedTimer order_timer("catalogue.hilbert_stop_order"sv);
+        std::vector<const QueryInputStop*> present;
+        std::vector<geo::Coordinates> points;
+        for (const auto& stop : stops) {
+            if (stop) {
+                present.push_back(&*stop);
+                points.push_back(stop->coord);
+            }
+        }
+        for (const size_t index : geo::HilbertOrder(points)) {
+            catalogue.AddStop(present[index]->name, present[index]->coord.lat, present[index]->coord.lng, {});
+        }
+    }
+    for (const auto& stop : stops) {
+        if (!stop) {
             continue;
         }
+        catalogue.AddStop(stop->name, stop->coord.lat, stop->coord.lng, stop->distances);
+        instrumentation::AddCounter("catalogue.stops"sv);
     }
 }
-    
-void JSONReader::AddToCatalog(json::Node node) {
+
+void JSONReader::AddBus(const std::vector<std::optional<QueryInputBus>>& queries, ThreadPool& pool) {
+    instrumentation::ScopedTimer timer("catalogue.add_buses"sv);
+    TransportCatalogue& catalogue = GetBaseCatalogue();
+    std::vector<Bus> buses(queries.size());
+    pool.ParallelFor(queries.size(), [&catalogue, &queries, &buses](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (queries[i]) {
+                buses[i] = catalogue.MakeBus(*queries[i]);
+            }
+        }
+    });
+    for (size_t i = 0; i < queries.size(); ++i) {
+        if (queries[i]) {
+            catalogue.AddBus(std::move(buses[i]));
+            instrumentation::AddCounter("catalogue.buses"sv);
+        }
+    }
+}
+
+// The requests are read out of the JSON in parallel and added in input order,
+// so the catalogue and the base file match a sequential build byte for byte.
+void JSONReader::AddToCatalog(const json::Node& node) {
     if (!node.IsArray()) {
         throw json::ParsingError("Incorrect input data type");
     }
     const json::Array& arr = node.AsArray();
-    AddStop(arr);
-    AddBus(arr);
+    std::vector<std::optional<QueryInputStop>> stops(arr.size());
+    std::vector<std::optional<QueryInputBus>> buses(arr.size());
+    TransportCatalogue& catalogue = GetBaseCatalogue();
+    ThreadPool& pool = GetThreadPool();
+    {
+        instrumentation::ScopedTimer timer("catalogue.read_base_requests"sv);
+        pool.ParallelFor(arr.size(), [this, &arr, &stops, &buses](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const json::Dict& dict = arr[i].AsMap();
+                const auto type_i = dict.find("type"s);
+                if (type_i == dict.end()) {
+                    continue;
+                }
+                if (type_i->second == "Stop"s) {
+                    stops[i] = ReadBaseStop(dict);
+                } else if (type_i->second == "Bus"s) {
+                      buses[i] = ReadBaseBus(dict);
+                  }
+            }
+        });
+    }
+    AddStop(stops);
+    // The stop index depends on the stops only and is built while buses are added.
+    auto stop_index = std::async(std::launch::async, [&catalogue]() {
+        instrumentation::ScopedTimer timer("catalogue.build_stop_index"sv);
+        catalogue.BuildStopIndex();
+    });
+    AddBus(buses, pool);
+    {
+        instrumentation::ScopedTimer timer("catalogue.build_stop_components"sv);
+        catalogue.BuildStopComponents();
+    }
+    stop_index.get();
 }
     
-void JSONReader::FillMap(int id) {
+json::Dict JSONReader::FillMap() {
+    instrumentation::ScopedTimer timer("request.Map"sv);
+    if (rendered_map_) {
+        return json::Dict{{"map"s, *rendered_map_}};
+    }
     renderer::MapRenderer svg_map(render_settings_);
     std::ostringstream stream;
     svg_map.RenderSvgMap(transport_catalogue_, stream);
     json::Dict result;
-    result.emplace("request_id"s, id);
     result.emplace("map"s, std::move(stream.str()));
-    request_to_output_.push_back(json::Node(result));
+    return result;
 }
     
-void JSONReader::FillRout(int id, const json::Dict& request_fields) {
-    json::Array out;
-    std::string stop_from;
-    std::string stop_to;
-    if (const auto from_i = request_fields.find("from"s); from_i != request_fields.end() && from_i->second.IsString()) {
-        stop_from = from_i->second.AsString();
-    }
-    if (const auto to_i = request_fields.find("to"s); to_i != request_fields.end()){
-        stop_to = to_i -> second.AsString();
-    }
-    int id_from = transport_catalogue_.FindStop(stop_from) -> id;
-    int id_to = transport_catalogue_.FindStop(stop_to) -> id;
-    auto get_find_route = router_.GetRouteStat(id_from, id_to);
+std::optional<RoutePoint> JSONReader::GetRoutePoint(const std::string& stop_name, const std::optional<geo::Coordinates>& point) {
+    if (point) {
+        return RoutePoint{std::nullopt, *point};
+    }
+    const Stop* stop = transport_catalogue_.FindStop(stop_name);
+    if (!stop) {
+        return std::nullopt;
+    }
+    return RoutePoint{static_cast<size_t>(stop->id), stop->coord};
+}
+
+json::Dict JSONReader::FillRout(const StatRequest& request) {
+    const auto from = GetRoutePoint(request.from, request.from_point);
+    const auto to = GetRoutePoint(request.to, request.to_point);
+    if (!from || !to) {
+        return GetErrorDict();
+    }
+    // The Pareto set and the alternatives are searched between stops over the frequency model.
+    if ((request.pareto || request.alternatives > 1) && from->stop_id && to->stop_id) {
+        const std::vector<RouteStatistic> route_stats = request.pareto
+            ? router_.GetParetoRouteStats(*from->stop_id, *to->stop_id)
+            : router_.GetAlternativeRouteStats(*from->stop_id, *to->stop_id, static_cast<size_t>(request.alternatives));
+        if (route_stats.empty()) {
+            return GetErrorDict();
+        }
+        json::Array routes;
+        for (const RouteStatistic& route_stat : route_stats) {
+            json::Dict route = FillRouteStat(route_stat);
+            const auto rides = std::count_if(route_stat.items.begin(), route_stat.items.end(), [](const RouteStatistic::VariantItem& item) {
+                return std::holds_alternative<RouteStatistic::ItemsBus>(item);
+            });
+            route.insert({"transfer_count"s, static_cast<int>(std::max<std::ptrdiff_t>(rides - 1, 0))});
+            routes.push_back(std::move(route));
+        }
+        json::Dict result = FillRouteStat(route_stats.front());
+        result.insert({"routes"s, std::move(routes)});
+        return result;
+    }
+    Disruption disruption;
+    for (const std::string& stop_name : request.closed_stops) {
+        if (const Stop* stop = transport_catalogue_.FindStop(stop_name)) {
+            disruption.closed_stops.push_back(static_cast<size_t>(stop->id));
+        }
+    }
+    disruption.suspended_buses.assign(request.suspended_buses.begin(), request.suspended_buses.end());
+    // A departure time switches stop-to-stop routes to the timetable when the base has one.
+    const bool by_timetable = request.departure_time && from->stop_id && to->stop_id && router_.HasTimetable();
+    RoutingSettings settings = router_.settings_;
+    settings.bus_wait_time_ = request.bus_wait_time.value_or(settings.bus_wait_time_);
+    settings.bus_velocity_ = request.bus_velocity.value_or(settings.bus_velocity_);
+    settings.walking_velocity_ = request.walking_velocity.value_or(settings.walking_velocity_);
+    auto get_find_route = by_timetable ? router_.GetRouteStat(*from->stop_id, *to->stop_id, *request.departure_time) : router_.GetRouteStat(*from, *to, disruption, settings);
     if (get_find_route == std::nullopt) {
-        json::Node dict_node_stop{json::Dict{{"request_id"s,    id},
-                                             {"error_message"s, "not found"s}}};
-        request_to_output_.push_back({dict_node_stop});
-        return;
+        return GetErrorDict();
     }
+    json::Dict rout_stat_dict = FillRouteStat(*get_find_route);
+    if (by_timetable) {
+        rout_stat_dict.insert({"arrival_time", *request.departure_time + get_find_route -> total_time});
+    }
+    return rout_stat_dict;
+}
+
+json::Dict JSONReader::FillRouteStat(const RouteStatistic& route_stat) const {
     json::Array items;
-    for (const auto &get_f_r : get_find_route -> items) {
+    for (const auto &get_f_r : route_stat.items) {
         json::Dict dict;
         if(std::holds_alternative<RouteStatistic::ItemsWait>(get_f_r)) {
             auto it = std::get<RouteStatistic::ItemsWait>(get_f_r);
@@ -222,96 +419,333 @@ void JSONReader::FillRout(int id, const json::Dict& request_fields) {
             dict.insert({"span_count"s, static_cast<int>(it.span_count)});
             dict.insert({"time"s, it.time});
             dict.insert({"type"s, it.type});
-        }
+        } else if (std::holds_alternative<RouteStatistic::ItemsWalk>(get_f_r)) {
+              auto it = std::get<RouteStatistic::ItemsWalk>(get_f_r);
+              dict.insert({"distance"s, it.distance});
+              dict.insert({"time"s, it.time});
+              dict.insert({"type"s, it.type});
+          }
         items.push_back(dict);
     }
     json::Dict rout_stat_dict;
     rout_stat_dict.insert({"items", items});
-    rout_stat_dict.insert({"request_id", id});
-    rout_stat_dict.insert({"total_time", get_find_route -> total_time});
-    request_to_output_.push_back(rout_stat_dict);
+    rout_stat_dict.insert({"total_time", route_stat.total_time});
+    return rout_stat_dict;
 }
 
-void JSONReader::FillStop(const std::string& name, int id) {
+json::Dict JSONReader::FillNearbyStops(const std::vector<StopIndex::Neighbour>& neighbours) {
+    json::Array stops;
+    stops.reserve(neighbours.size());
+    for (const auto& neighbour : neighbours) {
+        json::Dict stop;
+        stop.emplace("name"s, transport_catalogue_.FindStopById(neighbour.stop_id)->name);
+        stop.emplace("distance"s, neighbour.distance);
+        stops.emplace_back(std::move(stop));
+    }
+    json::Dict result;
+    result.emplace("stops"s, std::move(stops));
+    return result;
+}
+
+json::Dict JSONReader::FillStop(const std::string& name) {
     json::Dict result;
     json::Array buses;
     const std::optional<std::set<std::string>>& bus_routes = transport_catalogue_.GetStopInfo(name);
     for (auto bus_route : *bus_routes) {
         buses.emplace_back(std::string{bus_route});
     }
-    result.emplace("request_id"s, id);
     result.emplace("buses"s, buses);
-    request_to_output_.push_back(json::Node(result));
+    return result;
 }
 
-void JSONReader::FillBus(Bus* bus, int id) {
+json::Dict JSONReader::FillBus(const Bus* bus) {
     BusQueryInput info = transport_catalogue_.GetBusInfo(*bus);
     json::Dict result;
-    result.emplace("request_id"s, id);
     result.emplace("curvature"s, info.curvature);
     result.emplace("route_length"s, static_cast<int>(info.route_length));
     result.emplace("stop_count"s, static_cast<int>(info.stops_count));
     result.emplace("unique_stop_count"s, static_cast<int>(info.unique_stops_count));
-    request_to_output_.push_back(json::Node(result));
+    return result;
 }
 
-void JSONReader::FillOutput(json::Node request) {
-    if (!request.IsArray()){
-        throw json::ParsingError("Incorrect input data type");
+JSONReader::StatRequest JSONReader::ReadStatRequest(const json::Node& element) const {
+    if (!element.IsMap()) {
+        throw json::ParsingError("One of request nodes is not a dictionary.");
     }
-    const json::Array& arr = request.AsArray();
-    for (auto& element : arr){
-        if (!element.IsMap()) {
-            throw json::ParsingError("One of request nodes is not a dictionary.");
-        }
-        const json::Dict& request_fields = element.AsMap();
-        int id = -1;
-        if (const auto id_i = request_fields.find("id"s); id_i != request_fields.end() && id_i->second.IsInt()) {
-            id = id_i->second.AsInt();
-        } else{
-              throw json::ParsingError("Invalid field in request' node");
+    const json::Dict& request_fields = element.AsMap();
+    StatRequest request;
+    if (const auto id_i = request_fields.find("id"s); id_i != request_fields.end() && id_i->second.IsInt()) {
+        request.id = id_i->second.AsInt();
+    } else{
+          throw json::ParsingError("Invalid field in request' node");
+      }
+    const auto type_i = request_fields.find("type"s);
+    if ( type_i == request_fields.end() || !(type_i->second.IsString()) ){
+        throw json::ParsingError("Invalid field in request' node");
+    }
+    request.type = type_i->second.AsString();
+    if (request.type == "Map"s) {
+        return request;
+    } else if (request.type == "Route"s) {
+          // Either end is a stop name or a {"latitude", "longitude"} point.
+          auto read_end = [](const json::Node& node, std::string& name, std::optional<geo::Coordinates>& point) {
+              if (node.IsString()) {
+                  name = node.AsString();
+              } else if (node.IsMap()) {
+                    const json::Dict& fields = node.AsMap();
+                    const auto lat_i = fields.find("latitude"s);
+                    const auto lng_i = fields.find("longitude"s);
+                    if (lat_i == fields.end() || !lat_i->second.IsDouble() || lng_i == fields.end() || !lng_i->second.IsDouble()) {
+                        throw json::ParsingError("Invalid field in request' node");
+                    }
+                    point = geo::Coordinates{lat_i->second.AsDouble(), lng_i->second.AsDouble()};
+                }
+          };
+          if (const auto from_i = request_fields.find("from"s); from_i != request_fields.end()) {
+              read_end(from_i->second, request.from, request.from_point);
           }
-        const auto type_i = request_fields.find("type"s);
-        if ( type_i == request_fields.end() || !(type_i->second.IsString()) ){
-            throw json::ParsingError("Invalid field in request' node");
-        }
-        std::string type = type_i->second.AsString();
-        if ( type == "Map"s) {
-            FillMap(id);
-            continue;
-        } else if (type == "Route"s){
-              if (router_.IsExist()) { 
-                  router_.CreateGraph(transport_catalogue_); 
+          if (const auto to_i = request_fields.find("to"s); to_i != request_fields.end()){
+              read_end(to_i->second, request.to, request.to_point);
+          }
+          if (const auto departure_i = request_fields.find("departure_time"s); departure_i != request_fields.end()) {
+              if (!departure_i->second.IsDouble()) {
+                  throw json::ParsingError("Invalid field in request' node");
+              }
+              request.departure_time = departure_i->second.AsDouble();
+          }
+          if (const auto pareto_i = request_fields.find("pareto"s); pareto_i != request_fields.end()) {
+              if (!pareto_i->second.IsBool()) {
+                  throw json::ParsingError("Invalid field in request' node");
+              }
+              request.pareto = pareto_i->second.AsBool();
+          }
+          if (const auto alternatives_i = request_fields.find("alternatives"s); alternatives_i != request_fields.end()) {
+              if (!alternatives_i->second.IsInt() || alternatives_i->second.AsInt() < 1) {
+                  throw json::ParsingError("Invalid field in request' node");
               }
-              FillRout(id, request_fields); 
-              continue;
+              request.alternatives = alternatives_i->second.AsInt();
           }
-        std::string name;
-        if (const auto name_i = request_fields.find("name"s); name_i != request_fields.end() && name_i->second.IsString()) {
-            name = name_i->second.AsString();
-        } else {
+          auto read_names = [&request_fields](const std::string& key, std::vector<std::string>& names) {
+              const auto names_i = request_fields.find(key);
+              if (names_i == request_fields.end()) {
+                  return;
+              }
+              if (!names_i->second.IsArray()) {
+                  throw json::ParsingError("Invalid field in request' node");
+              }
+              for (const json::Node& name : names_i->second.AsArray()) {
+                  if (!name.IsString()) {
+                      throw json::ParsingError("Invalid field in request' node");
+                  }
+                  names.push_back(name.AsString());
+              }
+              std::sort(names.begin(), names.end());
+              names.erase(std::unique(names.begin(), names.end()), names.end());
+          };
+          read_names("closed_stops"s, request.closed_stops);
+          read_names("suspended_buses"s, request.suspended_buses);
+          auto read_setting = [&request_fields](const std::string& key, std::optional<double>& value, bool allow_zero) {
+              if (const auto setting_i = request_fields.find(key); setting_i != request_fields.end()) {
+                  if (!setting_i->second.IsDouble() || setting_i->second.AsDouble() < 0 || (!allow_zero && setting_i->second.AsDouble() == 0)) {
+                      throw json::ParsingError("Invalid field in request' node");
+                  }
+                  value = setting_i->second.AsDouble();
+              }
+          };
+          read_setting("bus_wait_time"s, request.bus_wait_time, true);
+          read_setting("bus_velocity"s, request.bus_velocity, false);
+          read_setting("walking_velocity"s, request.walking_velocity, false);
+          // Disruptions and setting overrides are applied by the per-query search of the frequency model only.
+          const bool per_query = !request.closed_stops.empty() || !request.suspended_buses.empty()
+              || request.bus_wait_time || request.bus_velocity || request.walking_velocity;
+          if (per_query && (request.pareto || request.alternatives > 1 || request.departure_time)) {
               throw json::ParsingError("Invalid field in request' node");
           }
-        if ( type == "Bus"s) {
-            Bus* bus = transport_catalogue_.FindBus(name);
-            if (!bus){
-                request_to_output_.push_back(GetErrorNode(id));
-                continue;
+          return request;
+      } else if (request.type == "NearbyStops"s || request.type == "NearestStops"s) {
+            const auto lat_i = request_fields.find("latitude"s);
+            const auto lng_i = request_fields.find("longitude"s);
+            if (lat_i == request_fields.end() || !lat_i->second.IsDouble() || lng_i == request_fields.end() || !lng_i->second.IsDouble()) {
+                throw json::ParsingError("Invalid field in request' node");
             }
-            FillBus(bus, id);
-        } else if (type == "Stop"s) {
-              if (!(transport_catalogue_.FindStop(name)) ) {
-                  request_to_output_.push_back(GetErrorNode(id));
-                  continue;
+            request.point = {lat_i->second.AsDouble(), lng_i->second.AsDouble()};
+            if (request.type == "NearbyStops"s) {
+                const auto radius_i = request_fields.find("radius"s);
+                if (radius_i == request_fields.end() || !radius_i->second.IsDouble()) {
+                    throw json::ParsingError("Invalid field in request' node");
+                }
+                request.radius = radius_i->second.AsDouble();
+            } else {
+                  const auto count_i = request_fields.find("count"s);
+                  if (count_i == request_fields.end() || !count_i->second.IsInt()) {
+                      throw json::ParsingError("Invalid field in request' node");
+                  }
+                  request.count = count_i->second.AsInt();
               }
-              FillStop(name, id);
-          } else{
-                throw json::ParsingError("Invalid stat request.");
-            } 
+            return request;
+        }
+    if (const auto name_i = request_fields.find("name"s); name_i != request_fields.end() && name_i->second.IsString()) {
+        request.name = name_i->second.AsString();
+    } else {
+          throw json::ParsingError("Invalid field in request' node");
+      }
+    if (request.type != "Bus"s && request.type != "Stop"s) {
+        throw json::ParsingError("Invalid stat request.");
+    }
+    return request;
+}
+
+// Strings are length-prefixed and optional fields carry a presence byte, so
+// the fields of two different requests can never run into the same key.
+std::string JSONReader::GetRequestKey(const StatRequest& request) const {
+    std::string key;
+    auto append_value = [&key](const auto& value) {
+        key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    auto append_string = [&key, &append_value](const std::string& value) {
+        append_value(value.size());
+        key += value;
+    };
+    auto append_optional = [&key, &append_value](const auto& value) {
+        key.push_back(value ? '\1' : '\0');
+        if (value) {
+            append_value(*value);
+        }
+    };
+    auto append_point = [&key, &append_value](const std::optional<geo::Coordinates>& point) {
+        key.push_back(point ? '\1' : '\0');
+        if (point) {
+            append_value(point->lat);
+            append_value(point->lng);
+        }
+    };
+    append_string(request.type);
+    if (request.type == "Route"s) {
+        append_string(request.from);
+        append_point(request.from_point);
+        append_string(request.to);
+        append_point(request.to_point);
+        append_optional(request.departure_time);
+        append_value(request.pareto);
+        append_value(request.alternatives);
+        for (const auto* names : {&request.closed_stops, &request.suspended_buses}) {
+            append_value(names->size());
+            for (const std::string& name : *names) {
+                append_string(name);
+            }
+        }
+        for (const auto* setting : {&request.bus_wait_time, &request.bus_velocity, &request.walking_velocity}) {
+            append_optional(*setting);
+        }
+    } else if (request.type == "NearbyStops"s || request.type == "NearestStops"s) {
+          for (double value : {request.point.lat, request.point.lng, request.radius, static_cast<double>(request.count)}) {
+              append_value(value);
+          }
+      } else {
+          append_string(request.name);
+      }
+    return key;
+}
+
+void JSONReader::AnswerRoutes(const std::vector<StatRequest>& unique_requests, std::vector<json::Dict>& answers) {
+    std::vector<size_t> routes;
+    for (size_t i = 0; i < unique_requests.size(); ++i) {
+        if (unique_requests[i].type == "Route"s) {
+            routes.push_back(i);
+        }
+    }
+    if (routes.empty()) {
+        return;
+    }
+    router_.AwaitBuild();
+    // Plain stop-to-stop queries sharing an origin are answered together: one
+    // row of the router table, or one search of a per-query engine.
+    const auto is_plain = [this](const StatRequest& request) {
+        return !request.from_point && !request.to_point && !request.departure_time && !request.pareto && request.alternatives == 1
+            && request.closed_stops.empty() && request.suspended_buses.empty()
+            && !request.bus_wait_time && !request.bus_velocity && !request.walking_velocity
+            && transport_catalogue_.FindStop(request.from) && transport_catalogue_.FindStop(request.to);
+    };
+    std::map<std::string_view, std::vector<size_t>> plain_by_origin;
+    for (size_t i : routes) {
+        if (is_plain(unique_requests[i])) {
+            plain_by_origin[unique_requests[i].from].push_back(i);
+            continue;
+        }
+        instrumentation::ScopedTimer timer("request.Route"sv);
+        answers[i] = FillRout(unique_requests[i]);
+    }
+    for (const auto& [from, group] : plain_by_origin) {
+        instrumentation::ScopedTimer timer("request.RouteGroup"sv);
+        std::vector<size_t> stops_to;
+        stops_to.reserve(group.size());
+        for (size_t i : group) {
+            stops_to.push_back(static_cast<size_t>(transport_catalogue_.FindStop(unique_requests[i].to)->id));
+        }
+        const auto route_stats = router_.GetRouteStats(static_cast<size_t>(transport_catalogue_.FindStop(from)->id), stops_to);
+        for (size_t j = 0; j < group.size(); ++j) {
+            answers[group[j]] = route_stats[j] ? FillRouteStat(*route_stats[j]) : GetErrorDict();
+        }
+    }
+}
+
+void JSONReader::FillOutput(const json::Node& request) {
+    if (!request.IsArray()){
+        throw json::ParsingError("Incorrect input data type");
+    }
+    const json::Array& arr = request.AsArray();
+    // Plan the whole batch first: identical queries are answered once and shared.
+    std::vector<StatRequest> requests;
+    std::vector<StatRequest> unique_requests;
+    std::unordered_map<std::string, size_t> request_index;
+    requests.reserve(arr.size());
+    for (const auto& element : arr){
+        StatRequest stat_request = ReadStatRequest(element);
+        const auto [it, inserted] = request_index.emplace(GetRequestKey(stat_request), unique_requests.size());
+        stat_request.answer = it->second;
+        if (inserted) {
+            unique_requests.push_back(stat_request);
+        }
+        requests.push_back(std::move(stat_request));
+    }
+    instrumentation::AddCounter("requests.total"sv, static_cast<int64_t>(requests.size()));
+    instrumentation::AddCounter("requests.unique"sv, static_cast<int64_t>(unique_requests.size()));
+    // The router is built while the other requests of the batch are answered;
+    // a read-only reader is given a router whose build has already started.
+    if (base_router_ && std::any_of(unique_requests.begin(), unique_requests.end(), [](const StatRequest& stat_request) {
+            return stat_request.type == "Route"s;
+        })) {
+        base_router_->StartBuild(GetBaseCatalogue(), GetThreadPool());
+    }
+    std::vector<json::Dict> answers(unique_requests.size());
+    for (size_t i = 0; i < unique_requests.size(); ++i) {
+        const StatRequest& stat_request = unique_requests[i];
+        if (stat_request.type == "Map"s) {
+            answers[i] = FillMap();
+            continue;
+        }
+        instrumentation::ScopedTimer timer(GetRequestTimerName(stat_request.type));
+        if (stat_request.type == "Bus"s) {
+              const Bus* bus = transport_catalogue_.FindBus(stat_request.name);
+              answers[i] = bus ? FillBus(bus) : GetErrorDict();
+          } else if (stat_request.type == "Stop"s) {
+                answers[i] = transport_catalogue_.FindStop(stat_request.name) ? FillStop(stat_request.name) : GetErrorDict();
+            } else if (stat_request.type == "NearbyStops"s) {
+                  answers[i] = FillNearbyStops(transport_catalogue_.GetStopIndex().FindInRadius(stat_request.point, stat_request.radius));
+              } else if (stat_request.type == "NearestStops"s) {
+                    answers[i] = FillNearbyStops(transport_catalogue_.GetStopIndex().FindNearest(stat_request.point, std::max(stat_request.count, 0)));
+                }
+    }
+    AnswerRoutes(unique_requests, answers);
+    request_to_output_.reserve(request_to_output_.size() + requests.size());
+    for (const StatRequest& stat_request : requests) {
+        json::Dict result = answers[stat_request.answer];
+        result.emplace("request_id"s, stat_request.id);
+        request_to_output_.push_back(json::Node(std::move(result)));
     }
 }
                    
-void JSONReader::ReadRenderSettings(json::Node node) {
+void JSONReader::ReadRenderSettings(const json::Node& node) {
     if (!node.IsMap()) {
         throw json::ParsingError("Error reading JSON data with render settings.");
     }
@@ -330,7 +764,7 @@ renderer::RenderSettings JSONReader::GetParsedRenderSettings(){
     settings.stop_label_font_size = settings_.at("stop_label_font_size"s).AsInt();
     settings.underlayer_width = settings_.at("underlayer_width"s).AsDouble();
     if (const auto field_iter = settings_.find("bus_label_offset"s); field_iter != settings_.end() && field_iter->second.IsArray()) {
-        json::Array arr = field_iter->second.AsArray();
+        const json::Array& arr = field_iter->second.AsArray();
         if (arr.size() != 2) throw json::ParsingError("Invaild bus label font offset data.");
         settings.bus_label_offset.x = arr[0].AsDouble();
         settings.bus_label_offset.y = arr[1].AsDouble();
@@ -338,7 +772,7 @@ renderer::RenderSettings JSONReader::GetParsedRenderSettings(){
           throw json::ParsingError("Invaild bus label font offset data.");
       }
     if (const auto field_iter = settings_.find("stop_label_offset"s); field_iter != settings_.end() && field_iter->second.IsArray()) {
-        json::Array arr = field_iter->second.AsArray();
+        const json::Array& arr = field_iter->second.AsArray();
         if (arr.size() != 2) throw json::ParsingError("Invaild stop label font offset data.");
         settings.stop_label_offset.x = arr[0].AsDouble();
         settings.stop_label_offset.y = arr[1].AsDouble();
@@ -357,7 +791,7 @@ renderer::RenderSettings JSONReader::GetParsedRenderSettings(){
         throw json::ParsingError("Invaild underlayer color data.");
     }
     if (const auto field_iter = settings_.find("color_palette"s); field_iter != settings_.end() && field_iter->second.IsArray()) {
-        json::Array arr = field_iter->second.AsArray();
+        const json::Array& arr = field_iter->second.AsArray();
         for (const auto& color_node : arr) {
             svg::Color color = ParseColor(color_node);
             if (std::holds_alternative<std::monostate>(color)) {
@@ -377,6 +811,36 @@ void JSONReader::SetRenderSettings(const renderer::RenderSettings &settings)
     render_settings_ = settings;
 }
 
+void JSONReader::SetRenderedMap(std::shared_ptr<const std::string> map)
+{
+    rendered_map_ = std::move(map);
+}
+
+void JSONReader::SetThreadPool(ThreadPool& pool) {
+    pool_ = &pool;
+}
+
+ThreadPool& JSONReader::GetThreadPool() const {
+    if (!pool_) {
+        throw std::logic_error("JSONReader has no thread pool");
+    }
+    return *pool_;
+}
+
+TransportCatalogue& JSONReader::GetBaseCatalogue() const {
+    if (!base_catalogue_) {
+        throw std::logic_error("JSONReader has a read-only catalogue");
+    }
+    return *base_catalogue_;
+}
+
+TransportRouter& JSONReader::GetBaseRouter() const {
+    if (!base_router_) {
+        throw std::logic_error("JSONReader has a read-only router");
+    }
+    return *base_router_;
+}
+
 serializator::SerializatorSettings JSONReader::GetSerializatorSettings()
 {
     return serializator_settings_;
@@ -387,11 +851,33 @@ RoutingSettings JSONReader::GetRoutingSettings()
     return router_.settings_;
 }
 
-inline json::Node GetErrorNode(int id) {
+instrumentation::InstrumentationSettings JSONReader::GetInstrumentationSettings()
+{
+    return instrumentation_settings_;
+}
+
+server::ServerSettings JSONReader::GetServerSettings()
+{
+    return server_settings_;
+}
+
+std::string_view GetRequestTimerName(std::string_view type) {
+    if (type == "Bus"sv) {
+        return "request.Bus"sv;
+    } else if (type == "Stop"sv) {
+          return "request.Stop"sv;
+      } else if (type == "NearbyStops"sv) {
+            return "request.NearbyStops"sv;
+        } else if (type == "NearestStops"sv) {
+              return "request.NearestStops"sv;
+          }
+    return "request.Other"sv;
+}
+
+json::Dict GetErrorDict() {
     json::Dict result;
-    result.emplace("request_id"s, id);
     result.emplace("error_message"s, "not found"s);
-    return {result};
+    return result;
 }
 
 svg::Color ParseColor(const json::Node& node){
@@ -399,7 +885,7 @@ svg::Color ParseColor(const json::Node& node){
         return {node.AsString()};
     }
     if (node.IsArray()) {
-        json::Array arr = node.AsArray();
+        const json::Array& arr = node.AsArray();
         if (arr.size() == 3) {
             uint8_t red = arr[0].AsInt();
             uint8_t green = arr[1].AsInt();
@@ -8,49 +8,109 @@
 #include "transport_catalogue.h"
 #include "map_renderer.h"
 #include "serialization.h"
+#include "instrumentation.h"
+#include "query_server.h"
+#include "thread_pool.h"
 
 namespace transport_catalogue{
 
-inline json::Node GetErrorNode(int id);
+json::Dict GetErrorDict();
+
+std::string_view GetRequestTimerName(std::string_view type);
 
 svg::Color ParseColor(const json::Node& node);
 
 class JSONReader{
 public:
-    JSONReader(TransportCatalogue& catalog, TransportRouter& router) : transport_catalogue_(catalog),  router_(router){};
+    JSONReader(TransportCatalogue& catalog, TransportRouter& router) : transport_catalogue_(catalog),  router_(router), base_catalogue_(&catalog), base_router_(&router){};
+    // Answers stat requests over a loaded base whose router build has already
+    // been started; filling the base or the routing settings throws.
+    JSONReader(const TransportCatalogue& catalog, const TransportRouter& router) : transport_catalogue_(catalog),  router_(router){};
 
     void MakeBase(std::istream& input);
     void ReadRawJson(std::istream& input, std::vector<json::Document>& document);
     void ParseBase();
-    void AddStop(const json::Array& arr);
-    void AddBus(const json::Array& arr);
-    void AddToCatalog(json::Node node);
+    void AddStop(const std::vector<std::optional<QueryInputStop>>& stops);
+    void AddBus(const std::vector<std::optional<QueryInputBus>>& queries, ThreadPool& pool);
+    void AddToCatalog(const json::Node& node);
     void AddRoutingSettings(const json::Node &root_);
-    void ReadRenderSettings(json::Node node);
+    void ReadRenderSettings(const json::Node& node);
     void Request(std::istream& input);
     void ParseSerializeSettings();
     void ParseStatRequest();
-    void FillMap(int id);
-    void FillOutput(json::Node node);
-    void FillStop(const std::string& name, int id);
-    void FillBus(Bus* bus, int id);
-    void FillRout(int id, const json::Dict& request_fields);
+    json::Dict FillMap();
+    void FillOutput(const json::Node& node);
+    json::Dict FillStop(const std::string& name);
+    json::Dict FillBus(const Bus* bus);
+    json::Dict FillNearbyStops(const std::vector<StopIndex::Neighbour>& neighbours);
     void ReadSerializationSettings(const json::Node &node);
+    void ReadInstrumentationSettings(const json::Node &node);
+    void ReadServerSettings(const json::Node &node);
     void OutputInfo(std::ostream& out);
+    json::Array TakeOutput();
     renderer::RenderSettings GetParsedRenderSettings();
     void SetRenderSettings(const renderer::RenderSettings& settings) ;
+    void SetRenderedMap(std::shared_ptr<const std::string> map);
+    // Runs the parallel stages of make_base and of the router build; it has
+    // to outlive the router.
+    void SetThreadPool(ThreadPool& pool);
     serializator::SerializatorSettings GetSerializatorSettings();
     RoutingSettings GetRoutingSettings();
+    instrumentation::InstrumentationSettings GetInstrumentationSettings();
+    server::ServerSettings GetServerSettings();
 
 private:
-    TransportCatalogue& transport_catalogue_;
-    TransportRouter& router_;
+    // One parsed stat request; identical requests share one answer slot.
+    struct StatRequest {
+        int id = -1;
+        std::string type;
+        std::string name;
+        std::string from;
+        std::string to;
+        std::optional<geo::Coordinates> from_point;
+        std::optional<geo::Coordinates> to_point;
+        std::optional<double> departure_time;
+        bool pareto = false;
+        int alternatives = 1;
+        // Sorted and unique, so that equal disruptions share an answer.
+        std::vector<std::string> closed_stops;
+        std::vector<std::string> suspended_buses;
+        // Overrides of the routing settings for this request only.
+        std::optional<double> bus_wait_time;
+        std::optional<double> bus_velocity;
+        std::optional<double> walking_velocity;
+        geo::Coordinates point{0, 0};
+        double radius = 0;
+        int count = 0;
+        size_t answer = 0;
+    };
+
+    StatRequest ReadStatRequest(const json::Node& element) const;
+    std::optional<QueryInputStop> ReadBaseStop(const json::Dict& dict) const;
+    std::optional<QueryInputBus> ReadBaseBus(const json::Dict& dict) const;
+    json::Dict FillRout(const StatRequest& request);
+    json::Dict FillRouteStat(const RouteStatistic& route_stat) const;
+    ThreadPool& GetThreadPool() const;
+    TransportCatalogue& GetBaseCatalogue() const;
+    TransportRouter& GetBaseRouter() const;
+    std::optional<RoutePoint> GetRoutePoint(const std::string& stop_name, const std::optional<geo::Coordinates>& point);
+    std::string GetRequestKey(const StatRequest& request) const;
+    void AnswerRoutes(const std::vector<StatRequest>& unique_requests, std::vector<json::Dict>& answers);
+
+    const TransportCatalogue& transport_catalogue_;
+    const TransportRouter& router_;
+    TransportCatalogue* base_catalogue_ = nullptr;
+    TransportRouter* base_router_ = nullptr;
     std::vector<json::Document> base_document_;
     std::vector<json::Document> request_document_;
     std::vector<json::Node> request_to_output_;
     json::Dict settings_;
     renderer::RenderSettings render_settings_;
+    ThreadPool* pool_ = nullptr;
+    std::shared_ptr<const std::string> rendered_map_;
     serializator::SerializatorSettings serializator_settings_;
+    instrumentation::InstrumentationSettings instrumentation_settings_;
+    server::ServerSettings server_settings_;
     int bus_wait_time_;
     double bus_velocity_;
     
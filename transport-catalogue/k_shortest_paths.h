@@ -0,0 +1,144 @@
+#pragma once
+
+#include "graph_search.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace graph {
+
+// Yen's K shortest loopless paths on top of ShortestPathSearch. Each found
+// path spawns one spur search per vertex on it, with the edges taken by
+// earlier paths from the same root and the root vertices blocked. The
+// settled vertices of all spur searches are summed against work_limit, and
+// the search returns the paths found so far once it is exceeded.
+template <typename Weight, typename Index = size_t>
+class KShortestPaths {
+private:
+    using Graph = DirectedWeightedGraph<Weight, Index>;
+
+public:
+    struct RouteInfo {
+        Weight weight;
+        std::vector<EdgeId> edges;
+    };
+
+    // Paths failing accept are enumerated but not returned.
+    using Filter = std::function<bool(const std::vector<EdgeId>&)>;
+
+    explicit KShortestPaths(const Graph& graph);
+
+    // Passed to the spur searches, which all end at the same target.
+    void SetHeuristic(typename ShortestPathSearch<Weight, Index>::Heuristic heuristic);
+
+    // Up to count paths by increasing weight.
+    std::vector<RouteInfo> BuildRoutes(VertexId from, VertexId to, size_t count, size_t work_limit, const Filter& accept = {});
+
+    size_t GetSettledCount() const;
+    size_t GetSpurSearchCount() const;
+    bool IsTruncated() const;
+
+private:
+    const Graph& graph_;
+    ShortestPathSearch<Weight, Index> search_;
+    size_t settled_count_ = 0;
+    size_t spur_search_count_ = 0;
+    bool truncated_ = false;
+};
+
+template <typename Weight, typename Index>
+KShortestPaths<Weight, Index>::KShortestPaths(const Graph& graph)
+    : graph_(graph)
+    , search_(graph) {
+}
+
+template <typename Weight, typename Index>
+std::vector<typename KShortestPaths<Weight, Index>::RouteInfo>
+KShortestPaths<Weight, Index>::BuildRoutes(VertexId from, VertexId to, size_t count, size_t work_limit, const Filter& accept) {
+    settled_count_ = 0;
+    spur_search_count_ = 0;
+    truncated_ = false;
+    std::vector<RouteInfo> routes;
+    if (count == 0) {
+        return routes;
+    }
+    auto first = search_.BuildRoute(from, to);
+    settled_count_ += search_.GetSettledCount();
+    if (!first) {
+        return routes;
+    }
+    // Every path found so far, including the filtered out ones.
+    std::vector<RouteInfo> found{{first->weight, std::move(first->edges)}};
+    std::vector<RouteInfo> candidates;
+    for (size_t current = 0; ; ++current) {
+        const RouteInfo& path = found[current];
+        if (!accept || accept(path.edges)) {
+            routes.push_back(path);
+            if (routes.size() == count) {
+                break;
+            }
+        }
+        Weight root_weight{};
+        VertexId spur = from;
+        for (size_t i = 0; i < path.edges.size() && !truncated_; ++i) {
+            for (const RouteInfo& other : found) {
+                if (other.edges.size() > i && std::equal(path.edges.begin(), path.edges.begin() + i, other.edges.begin())) {
+                    search_.BlockEdge(other.edges[i]);
+                }
+            }
+            for (size_t j = 0; j < i; ++j) {
+                search_.BlockVertex(graph_.GetEdge(path.edges[j]).from);
+            }
+            auto spur_route = search_.BuildRoute(spur, to);
+            search_.ClearBlocked();
+            settled_count_ += search_.GetSettledCount();
+            ++spur_search_count_;
+            if (spur_route) {
+                RouteInfo candidate{root_weight + spur_route->weight, {path.edges.begin(), path.edges.begin() + i}};
+                candidate.edges.insert(candidate.edges.end(), spur_route->edges.begin(), spur_route->edges.end());
+                const auto same_edges = [&candidate](const RouteInfo& route) {
+                    return route.edges == candidate.edges;
+                };
+                if (std::none_of(candidates.begin(), candidates.end(), same_edges) && std::none_of(found.begin(), found.end(), same_edges)) {
+                    candidates.push_back(std::move(candidate));
+                }
+            }
+            truncated_ = settled_count_ >= work_limit;
+            const auto& edge = graph_.GetEdge(path.edges[i]);
+            root_weight += edge.weight;
+            spur = edge.to;
+        }
+        if (candidates.empty() || truncated_) {
+            break;
+        }
+        const auto best = std::min_element(candidates.begin(), candidates.end(), [](const RouteInfo& lhs, const RouteInfo& rhs) {
+            return lhs.weight < rhs.weight || (!(rhs.weight < lhs.weight) && lhs.edges.size() < rhs.edges.size());
+        });
+        found.push_back(std::move(*best));
+        candidates.erase(best);
+    }
+    return routes;
+}
+
+template <typename Weight, typename Index>
+void KShortestPaths<Weight, Index>::SetHeuristic(typename ShortestPathSearch<Weight, Index>::Heuristic heuristic) {
+    search_.SetHeuristic(std::move(heuristic));
+}
+
+template <typename Weight, typename Index>
+size_t KShortestPaths<Weight, Index>::GetSettledCount() const {
+    return settled_count_;
+}
+
+template <typename Weight, typename Index>
+size_t KShortestPaths<Weight, Index>::GetSpurSearchCount() const {
+    return spur_search_count_;
+}
+
+template <typename Weight, typename Index>
+bool KShortestPaths<Weight, Index>::IsTruncated() const {
+    return truncated_;
+}
+
+}  // namespace graph
@@ -1,23 +1,91 @@
 #include "json.h"
 #include "json_reader.h"
-#include "request_handler.h"
+#include "serialization.h"
 #include "transport_router.h"
+#include "instrumentation.h"
+#include "query_server.h"
 
-int main() {
-    using namespace std;
+using namespace std::literals;
+
+void PrintUsage(std::ostream& stream = std::cerr) {
+    stream << "Usage: transport_catalogue [make_base|process_requests|serve]\n"sv;
+}
+
+void MakeBase(std::istream& input) {
+    using namespace transport_catalogue;
+    ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u));
+    TransportCatalogue catalogue;
+    TransportRouter router;
+    JSONReader json_reader(catalogue, router);
+    json_reader.SetThreadPool(pool);
+    json_reader.MakeBase(input);
+    serializator::Serializator serializator(catalogue, router);
+    serializator.SetSetting(json_reader.GetSerializatorSettings());
+    serializator.SetRendererSettings(json_reader.GetParsedRenderSettings());
+    serializator.SetRouterSettings(json_reader.GetRoutingSettings());
+    serializator.Serialize();
+    instrumentation::Registry::Instance().WriteReport("make_base"sv, json_reader.GetInstrumentationSettings());
+}
+
+void ProcessRequests(std::istream& input, std::ostream& output) {
     using namespace transport_catalogue;
-    using namespace transport_catalogue::json;
-    
+    ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u));
     TransportCatalogue catalogue;
-    renderer::MapRenderer map_renderer;
-    JSONReader json_reader(catalogue, map_renderer);
-    Data data = std::move(json_reader.ReadJSON(std::cin));
-    TransportRouter transport_router(catalogue, data.routing_settings);
-    RequestHandler request_handler(catalogue, map_renderer, transport_router);
-    json_reader.BuildDataBase(data);
-    transport_router.BuildGraphAndRouter();
-    Document answers = std::move(json_reader.GenerateAnswer(transport_router, data.stat_requests));
-    Print(answers, std::cout);
-	
+    TransportRouter router;
+    JSONReader json_reader(catalogue, router);
+    json_reader.SetThreadPool(pool);
+    json_reader.Request(input);
+    serializator::Serializator serializator(catalogue, router);
+    serializator.SetSetting(json_reader.GetSerializatorSettings());
+    if (!serializator.Deserialize()) {
+        throw std::runtime_error("Failed to read base "s + json_reader.GetSerializatorSettings().path.string());
+    }
+    json_reader.SetRenderSettings(serializator.GetRenderSettings());
+    json_reader.ParseStatRequest();
+    json_reader.OutputInfo(output);
+    instrumentation::Registry::Instance().WriteReport("process_requests"sv, json_reader.GetInstrumentationSettings());
+}
+
+// The first JSON document on the input carries the settings; in stdin mode
+// every following line is a request.
+void Serve(std::istream& input, std::ostream& output) {
+    using namespace transport_catalogue;
+    ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u));
+    TransportCatalogue catalogue;
+    TransportRouter router;
+    JSONReader json_reader(catalogue, router);
+    json_reader.SetThreadPool(pool);
+    json_reader.Request(input);
+    const server::ServerSettings settings = json_reader.GetServerSettings();
+    server::QueryServer query_server(server::CatalogueSnapshot::Load(json_reader.GetSerializatorSettings(), pool), settings, pool);
+    if (settings.socket_path.empty()) {
+        query_server.ServeStream(input, output);
+    } else {
+          query_server.ServeSocket();
+      }
+    instrumentation::Registry::Instance().WriteReport("serve"sv, json_reader.GetInstrumentationSettings());
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        PrintUsage();
+        return 1;
+    }
+    const std::string_view mode(argv[1]);
+    try {
+        if (mode == "make_base"sv) {
+            MakeBase(std::cin);
+        } else if (mode == "process_requests"sv) {
+              ProcessRequests(std::cin, std::cout);
+          } else if (mode == "serve"sv) {
+                Serve(std::cin, std::cout);
+            } else {
+                PrintUsage();
+                return 1;
+            }
+    } catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
     return 0;
 }
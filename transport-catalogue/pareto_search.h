@@ -0,0 +1,127 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <tuple>
+#include <vector>
+
+namespace graph {
+
+// Label-setting search for all Pareto-optimal paths over (weight, edge count).
+// Labels leave the queue by weight, then by edge count, so a label is
+// dominated exactly when its vertex already settled one with no more edges.
+// Every vertex thus keeps at most max_edges labels, and label_limit caps the
+// total work of one query; a capped search returns what it settled so far.
+template <typename Weight, typename Index = size_t>
+class ParetoSearch {
+private:
+    using Graph = DirectedWeightedGraph<Weight, Index>;
+
+public:
+    struct RouteInfo {
+        Weight weight;
+        std::vector<EdgeId> edges;
+    };
+
+    explicit ParetoSearch(const Graph& graph);
+
+    // Routes by increasing weight and strictly decreasing edge count.
+    std::vector<RouteInfo> BuildRoutes(VertexId from, VertexId to, size_t max_edges, size_t label_limit);
+
+    size_t GetLabelCount() const;
+    size_t GetSettledCount() const;
+    bool IsTruncated() const;
+
+private:
+    static constexpr size_t NO_LABEL = std::numeric_limits<size_t>::max();
+
+    struct Label {
+        VertexId vertex;
+        EdgeId edge;
+        size_t parent;
+    };
+
+    const Graph& graph_;
+    std::vector<Label> labels_;
+    size_t settled_count_ = 0;
+    bool truncated_ = false;
+};
+
+template <typename Weight, typename Index>
+ParetoSearch<Weight, Index>::ParetoSearch(const Graph& graph)
+    : graph_(graph) {
+}
+
+template <typename Weight, typename Index>
+std::vector<typename ParetoSearch<Weight, Index>::RouteInfo>
+ParetoSearch<Weight, Index>::BuildRoutes(VertexId from, VertexId to, size_t max_edges, size_t label_limit) {
+    using QueueItem = std::tuple<Weight, size_t, size_t>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    labels_.clear();
+    settled_count_ = 0;
+    truncated_ = false;
+    // Fewest edges among the labels settled at every vertex.
+    std::vector<size_t> min_edges(graph_.GetVertexCount(), NO_LABEL);
+    std::vector<RouteInfo> routes;
+
+    labels_.push_back({from, 0, NO_LABEL});
+    queue.push({Weight{}, 0, 0});
+    while (!queue.empty()) {
+        const auto [weight, edge_count, label_id] = queue.top();
+        queue.pop();
+        const VertexId vertex = labels_[label_id].vertex;
+        // Anything not better than a route already found is dominated there too.
+        if (edge_count >= min_edges.at(vertex) || edge_count >= min_edges[to]) {
+            continue;
+        }
+        min_edges[vertex] = edge_count;
+        ++settled_count_;
+        if (vertex == to) {
+            RouteInfo route{weight, {}};
+            for (size_t id = label_id; labels_[id].parent != NO_LABEL; id = labels_[id].parent) {
+                route.edges.push_back(labels_[id].edge);
+            }
+            std::reverse(route.edges.begin(), route.edges.end());
+            routes.push_back(std::move(route));
+            continue;
+        }
+        if (edge_count == max_edges || truncated_) {
+            continue;
+        }
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            if (edge_count + 1 >= min_edges[edge.to] || edge_count + 1 >= min_edges[to]) {
+                continue;
+            }
+            if (labels_.size() >= label_limit) {
+                truncated_ = true;
+                break;
+            }
+            labels_.push_back({edge.to, edge_id, label_id});
+            queue.push({weight + edge.weight, edge_count + 1, labels_.size() - 1});
+        }
+    }
+    return routes;
+}
+
+template <typename Weight, typename Index>
+size_t ParetoSearch<Weight, Index>::GetLabelCount() const {
+    return labels_.size();
+}
+
+template <typename Weight, typename Index>
+size_t ParetoSearch<Weight, Index>::GetSettledCount() const {
+    return settled_count_;
+}
+
+template <typename Weight, typename Index>
+bool ParetoSearch<Weight, Index>::IsTruncated() const {
+    return truncated_;
+}
+
+}  // namespace graph
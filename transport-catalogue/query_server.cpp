@@ -0,0 +1,220 @@
+#include "query_server.h"
+#include "json_reader.h"
+#include "instrumentation.h"
+
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std::literals;
+
+namespace server {
+
+QueryServer::QueryServer(SnapshotPtr snapshot, ServerSettings settings, ThreadPool& build_pool)
+    : snapshot_(std::move(snapshot))
+    , settings_(std::move(settings))
+    , build_pool_(build_pool)
+    , pool_(settings_.threads) {
+}
+
+QueryServer::~QueryServer() {
+    std::lock_guard guard(reload_mutex_);
+    if (reloader_.joinable()) {
+        reloader_.join();
+    }
+}
+
+SnapshotPtr QueryServer::GetSnapshot() const {
+    return std::atomic_load(&snapshot_);
+}
+
+void QueryServer::Reload(serializator::SerializatorSettings settings) {
+    std::lock_guard guard(reload_mutex_);
+    if (reloader_.joinable()) {
+        reloader_.join();
+    }
+    reloader_ = std::thread([this, settings = std::move(settings)]() {
+        try {
+            SnapshotPtr snapshot = CatalogueSnapshot::Load(settings, build_pool_);
+            std::atomic_store(&snapshot_, std::move(snapshot));
+            instrumentation::AddCounter("server.reloads"sv);
+        } catch (const std::exception& error) {
+            std::cerr << "Reload failed: "sv << error.what() << std::endl;
+        }
+    });
+}
+
+std::string QueryServer::Answer(const std::string& line) {
+    instrumentation::ScopedTimer timer("server.answer"sv);
+    json::Node answer;
+    try {
+        std::istringstream input(line);
+        const json::Node request = json::Load(input).GetRoot();
+        if (request.IsMap() && request.AsMap().count("serialization_settings"s) && !request.AsMap().count("stat_requests"s)) {
+            const std::string file = request.AsMap().at("serialization_settings"s).AsMap().at("file"s).AsString();
+            Reload({file});
+            return "{\"reload\":\"started\"}"s;
+        }
+        const SnapshotPtr snapshot = GetSnapshot();
+        JSONReader json_reader(snapshot->GetCatalogue(), snapshot->GetRouter());
+        json_reader.SetRenderSettings(snapshot->GetRenderSettings());
+        json_reader.SetRenderedMap(snapshot->GetRenderedMap());
+        json_reader.SetThreadPool(build_pool_);
+        if (request.IsMap() && !request.AsMap().count("stat_requests"s)) {
+            json_reader.FillOutput(json::Array{request});
+            answer = json_reader.TakeOutput().front();
+        } else {
+              json_reader.FillOutput(request.IsMap() ? request.AsMap().at("stat_requests"s) : request);
+              answer = json_reader.TakeOutput();
+          }
+    } catch (const std::exception& error) {
+        answer = json::Dict{{"error_message"s, std::string{error.what()}}};
+    }
+    std::ostringstream output;
+    json::PrintCompact(json::Document{answer}, output);
+    return output.str();
+}
+
+void QueryServer::ServeStream(std::istream& input, std::ostream& output) {
+    // Lines are answered on the pool while a writer prints the answers in input order.
+    std::queue<std::future<std::string>> answers;
+    std::mutex mutex;
+    std::condition_variable has_answer;
+    bool input_done = false;
+    std::thread writer([&]() {
+        while (true) {
+            std::future<std::string> answer;
+            {
+                std::unique_lock lock(mutex);
+                has_answer.wait(lock, [&]() {
+                    return input_done || !answers.empty();
+                });
+                if (answers.empty()) {
+                    return;
+                }
+                answer = std::move(answers.front());
+                answers.pop();
+            }
+            output << answer.get() << std::endl;
+        }
+    });
+    for (std::string line; std::getline(input, line);) {
+        if (line.find_first_not_of(" \t\r"sv) == std::string::npos) {
+            continue;
+        }
+        auto answer = pool_.Submit([this, line = std::move(line)]() {
+            return Answer(line);
+        });
+        {
+            std::lock_guard guard(mutex);
+            answers.push(std::move(answer));
+        }
+        has_answer.notify_one();
+    }
+    {
+        std::lock_guard guard(mutex);
+        input_done = true;
+    }
+    has_answer.notify_one();
+    writer.join();
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+void QueryServer::ServeSocket() {
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw std::runtime_error("Failed to create socket"s);
+    }
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    const std::string path = settings_.socket_path.string();
+    if (path.size() >= sizeof(address.sun_path)) {
+        close(listener);
+        throw std::runtime_error("Socket path is too long: "s + path);
+    }
+    std::copy(path.begin(), path.end(), address.sun_path);
+    unlink(path.c_str());
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || listen(listener, SOMAXCONN) < 0) {
+        close(listener);
+        throw std::runtime_error("Failed to listen on "s + path);
+    }
+    // Every connection has its own reader, so idle clients never hold a pool
+    // worker; only answering a line runs on the pool. Readers of closed
+    // connections are reaped on the next accept and the rest awaited on exit.
+    std::vector<std::future<void>> connections;
+    while (true) {
+        const int connection = accept(listener, nullptr, nullptr);
+        if (connection < 0) {
+            break;
+        }
+        connections.erase(std::remove_if(connections.begin(), connections.end(), [](const std::future<void>& reader) {
+            return reader.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }), connections.end());
+        connections.push_back(std::async(std::launch::async, [this, connection]() {
+            ServeConnection(connection);
+        }));
+    }
+    close(listener);
+    unlink(path.c_str());
+}
+
+void QueryServer::ServeConnection(int connection) {
+    // Answers one line; false once the client stops reading.
+    const auto answer_line = [this, connection](const std::string& line) {
+        if (line.find_first_not_of(" \t\r"sv) == std::string::npos) {
+            return true;
+        }
+        const std::string answer = pool_.Submit([this, &line]() {
+            return Answer(line);
+        }).get() + '\n';
+        for (size_t written = 0; written < answer.size();) {
+            const ssize_t result = write(connection, answer.data() + written, answer.size() - written);
+            if (result <= 0) {
+                return false;
+            }
+            written += static_cast<size_t>(result);
+        }
+        return true;
+    };
+    std::string buffer;
+    char chunk[65536];
+    while (true) {
+        const ssize_t received = read(connection, chunk, sizeof(chunk));
+        if (received <= 0) {
+            // A client may close its end right after the last request without
+            // a trailing newline.
+            if (received == 0) {
+                answer_line(buffer);
+            }
+            break;
+        }
+        buffer.append(chunk, static_cast<size_t>(received));
+        size_t line_begin = 0;
+        for (size_t line_end; (line_end = buffer.find('\n', line_begin)) != std::string::npos; line_begin = line_end + 1) {
+            if (!answer_line(buffer.substr(line_begin, line_end - line_begin))) {
+                close(connection);
+                return;
+            }
+        }
+        buffer.erase(0, line_begin);
+    }
+    close(connection);
+}
+
+#else
+
+void QueryServer::ServeSocket() {
+    throw std::runtime_error("Unix-domain sockets are not supported on this platform"s);
+}
+
+void QueryServer::ServeConnection(int) {
+}
+
+#endif
+
+} // namespace server
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "snapshot.h"
+#include "thread_pool.h"
+
+namespace server {
+
+using namespace transport_catalogue;
+
+struct ServerSettings {
+    // Listen on this Unix-domain socket; serve stdin/stdout when empty.
+    std::filesystem::path socket_path;
+    size_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+};
+
+// Long-running front end over a loaded base. Every input line is one JSON
+// value: a stat request, an array of them or a {"stat_requests": [...]} document.
+// Every answer is one line of compact JSON, written in input order.
+// A line holding only {"serialization_settings": {"file": ...}} loads that base
+// in the background and swaps it in when ready; requests keep being answered
+// from the previous snapshot meanwhile.
+class QueryServer {
+public:
+    // Reloaded bases build their routers on build_pool, kept apart from the
+    // pool answering requests, whose workers may be waiting for such a build.
+    QueryServer(SnapshotPtr snapshot, ServerSettings settings, ThreadPool& build_pool);
+    ~QueryServer();
+
+    std::string Answer(const std::string& line);
+    void Reload(serializator::SerializatorSettings settings);
+    SnapshotPtr GetSnapshot() const;
+    void ServeStream(std::istream& input, std::ostream& output);
+    void ServeSocket();
+
+private:
+    void ServeConnection(int connection);
+
+    // Read and replaced only through std::atomic_load / std::atomic_store, so a
+    // request holds on to the snapshot it started with for its whole lifetime.
+    SnapshotPtr snapshot_;
+    ServerSettings settings_;
+    std::mutex reload_mutex_;
+    std::thread reloader_;
+    ThreadPool& build_pool_;
+    ThreadPool pool_;
+};
+
+} // namespace server
@@ -2,12 +2,22 @@
 
 #include "graph.h"
 
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
 namespace graph {
 
-template <typename Weight>
+// All-pairs table built by Floyd-Warshall. A cell holds the weight and the
+// last edge of the best route in Weight and Index, with reserved values in
+// place of std::optional: with double and size_t a cell takes 16 bytes, with
+// uint32_t ids or float weights the table shrinks accordingly.
+template <typename Weight, typename Index = size_t>
 class Router {
 private:
-    using Graph = DirectedWeightedGraph<Weight>;
+    using Graph = DirectedWeightedGraph<Weight, Index>;
 
 public:
     explicit Router(const Graph& graph);
@@ -19,83 +29,102 @@ public:
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
 
+    // Bytes taken by a table for the given number of vertices.
+    static size_t GetTableBytes(size_t vertex_count) {
+        return vertex_count * vertex_count * sizeof(RouteInternalData);
+    }
+
 private:
     struct RouteInternalData {
-        Weight weight;
-        std::optional<EdgeId> prev_edge;
+        Weight weight = UNREACHABLE;
+        Index prev_edge = NO_EDGE;
     };
-    
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+
+    using RoutesInternalData = std::vector<RouteInternalData>;
+
+    RouteInternalData& GetCell(VertexId from, VertexId to) {
+        return routes_internal_data_[from * vertex_count_ + to];
+    }
+
+    const RouteInternalData& GetCell(VertexId from, VertexId to) const {
+        return routes_internal_data_[from * vertex_count_ + to];
+    }
 
     void InitializeRoutesInternalData(const Graph& graph) {
-        const size_t vertex_count = graph.GetVertexCount();
-        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            GetCell(vertex, vertex) = RouteInternalData{ZERO_WEIGHT, NO_EDGE};
             for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
                 const auto& edge = graph.GetEdge(edge_id);
                 if (edge.weight < ZERO_WEIGHT) {
                     throw std::domain_error("Edges' weights should be non-negative");
                 }
-                auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                    route_internal_data = RouteInternalData{edge.weight, edge_id};
+                auto& route_internal_data = GetCell(vertex, edge.to);
+                if (route_internal_data.weight > edge.weight) {
+                    route_internal_data = RouteInternalData{edge.weight, static_cast<Index>(edge_id)};
                 }
             }
         }
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-        auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-        const Weight candidate_weight = route_from.weight + route_to.weight;
-        if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-            route_relaxing = {candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
-        }
-    }
-
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-        for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-            if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                    if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
-                    }
+    void RelaxRoutesInternalDataThroughVertex(VertexId vertex_through) {
+        const RouteInternalData* row_through = &GetCell(vertex_through, 0);
+        for (VertexId vertex_from = 0; vertex_from < vertex_count_; ++vertex_from) {
+            const RouteInternalData route_from = GetCell(vertex_from, vertex_through);
+            if (route_from.weight == UNREACHABLE) {
+                continue;
+            }
+            RouteInternalData* row_from = &GetCell(vertex_from, 0);
+            for (VertexId vertex_to = 0; vertex_to < vertex_count_; ++vertex_to) {
+                const RouteInternalData& route_to = row_through[vertex_to];
+                if (route_to.weight == UNREACHABLE) {
+                    continue;
+                }
+                RouteInternalData& route_relaxing = row_from[vertex_to];
+                const Weight candidate_weight = route_from.weight + route_to.weight;
+                if (candidate_weight < route_relaxing.weight) {
+                    route_relaxing = {candidate_weight,
+                                      route_to.prev_edge != NO_EDGE ? route_to.prev_edge : route_from.prev_edge};
                 }
             }
         }
     }
 
     static constexpr Weight ZERO_WEIGHT{};
+    static constexpr Weight UNREACHABLE = std::numeric_limits<Weight>::max();
+    static constexpr Index NO_EDGE = std::numeric_limits<Index>::max();
     const Graph& graph_;
+    size_t vertex_count_;
     RoutesInternalData routes_internal_data_;
 };
 
-template <typename Weight>
-Router<Weight>::Router(const Graph& graph)
+template <typename Weight, typename Index>
+Router<Weight, Index>::Router(const Graph& graph)
     : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(), std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+    , vertex_count_(graph.GetVertexCount())
+    , routes_internal_data_(vertex_count_ * vertex_count_)
 {
     InitializeRoutesInternalData(graph);
-    const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+    for (VertexId vertex_through = 0; vertex_through < vertex_count_; ++vertex_through) {
+        RelaxRoutesInternalDataThroughVertex(vertex_through);
     }
 }
 
-template <typename Weight>
-std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from, VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-    if (!route_internal_data) {
+template <typename Weight, typename Index>
+std::optional<typename Router<Weight, Index>::RouteInfo> Router<Weight, Index>::BuildRoute(VertexId from, VertexId to) const {
+    if (from >= vertex_count_ || to >= vertex_count_) {
+        throw std::out_of_range("Vertex is out of the graph");
+    }
+    const RouteInternalData& route_internal_data = GetCell(from, to);
+    if (route_internal_data.weight == UNREACHABLE) {
         return std::nullopt;
     }
-    const Weight weight = route_internal_data->weight;
+    const Weight weight = route_internal_data.weight;
     std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-         edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+    for (Index edge_id = route_internal_data.prev_edge;
+         edge_id != NO_EDGE;
+         edge_id = GetCell(from, graph_.GetEdge(edge_id).from).prev_edge)
     {
-        edges.push_back(*edge_id);
+        edges.push_back(edge_id);
     }
     std::reverse(edges.begin(), edges.end());
     return RouteInfo{weight, std::move(edges)};
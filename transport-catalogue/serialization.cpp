@@ -1,6 +1,10 @@
 #include "serialization.h"
+#include "instrumentation.h"
 
-using namespace std::string_literals;
+#include <algorithm>
+#include <future>
+
+using namespace std::literals;
 
 namespace serializator {
 
@@ -18,44 +22,69 @@ void Serializator::SetRouterSettings(const RoutingSettings& settings){
     routing_settings_ = settings;
 }
 
+// The large sections only read the catalogue, so each is built on its own
+// thread into a detached repeated field and swapped into the message here.
 void Serializator::Serialize() {
-    std::ofstream out_file(serialization_settings_.path, std::ios::binary);
-    WriteStops();
-    WriteBuses();
-    WriteDistances();
+    instrumentation::ScopedTimer timer("serialization.serialize"sv);
+    auto stops = std::async(std::launch::async, [this]() {
+        return WriteStops();
+    });
+    auto buses = std::async(std::launch::async, [this]() {
+        return WriteBuses();
+    });
+    auto distances = std::async(std::launch::async, [this]() {
+        return WriteDistances();
+    });
     WriteMap();
     WriteRoutingSettings();
+    WriteStopIndex();
+    WriteStopComponents();
+    auto serialized_stops = stops.get();
+    proto_catalogue_.mutable_stops()->Swap(&serialized_stops);
+    auto serialized_buses = buses.get();
+    proto_catalogue_.mutable_buses()->Swap(&serialized_buses);
+    auto serialized_distances = distances.get();
+    proto_catalogue_.mutable_distances()->Swap(&serialized_distances);
+    std::ofstream out_file(serialization_settings_.path, std::ios::binary);
     proto_catalogue_.SerializeToOstream(&out_file);
 }
 
-void Serializator::Deserialize() {
+bool Serializator::Deserialize() {
+    instrumentation::ScopedTimer timer("serialization.deserialize"sv);
     std::ifstream in_file(serialization_settings_.path, std::ios::binary);
-    proto_catalogue_.ParseFromIstream(&in_file);
+    if (!in_file || !proto_catalogue_.ParseFromIstream(&in_file)) {
+        return false;
+    }
     ReadStops();
-    ReadBuses();
+    // The buses take their route distances from the catalogue as they are added.
     ReadDistances();
+    ReadBuses();
     ReadMap();
     ReadRoutingSettings();
+    ReadStopIndex();
+    ReadStopComponents();
+    return true;
 }
 
-void Serializator::WriteStops() {
-    const auto stops = catalogue_.GetStops();
-    std::vector<proto_catalogue::Stop> serialized_stops_list(stops.size());
-    *proto_catalogue_.mutable_stops() = {serialized_stops_list.begin(), serialized_stops_list.end() };
-    proto_catalogue_.mutable_stops()->Reserve(stops.size());
-    for (const auto& [stop_name, stop] : stops) {
-        proto_catalogue::Stop* serialized_stop = proto_catalogue_.mutable_stops(stop->id);
-        *serialized_stop->mutable_name() = stop_name;
-        serialized_stop->set_lat(stop->coord.lat);
-        serialized_stop->set_lng(stop->coord.lng);
-        serialized_stop->set_id(stop->id);
+google::protobuf::RepeatedPtrField<proto_catalogue::Stop> Serializator::WriteStops() const {
+    google::protobuf::RepeatedPtrField<proto_catalogue::Stop> serialized_stops;
+    serialized_stops.Reserve(static_cast<int>(catalogue_.GetAllStops().size()));
+    for (const Stop& stop : catalogue_.GetAllStops()) {
+        proto_catalogue::Stop* serialized_stop = serialized_stops.Add();
+        *serialized_stop->mutable_name() = stop.name;
+        serialized_stop->set_lat(stop.coord.lat);
+        serialized_stop->set_lng(stop.coord.lng);
+        serialized_stop->set_id(stop.id);
+        serialized_stop->set_has_coord(stop.has_coord);
     }
+    return serialized_stops;
 }
 
-void Serializator::WriteBuses() {
+google::protobuf::RepeatedPtrField<proto_catalogue::Bus> Serializator::WriteBuses() const {
+    google::protobuf::RepeatedPtrField<proto_catalogue::Bus> serialized_buses;
     for (auto& [bus_name, bus] : catalogue_.GetBuses()) {
-        proto_catalogue::Bus* serialized_bus = proto_catalogue_.add_buses();
-        *serialized_bus->mutable_name() = bus_name;
+        proto_catalogue::Bus* serialized_bus = serialized_buses.Add();
+        *serialized_bus->mutable_name() = std::string{bus_name};
         if (bus->type == RouteType::CIRCLE){
             serialized_bus->set_is_roundtrip(true);
         } else {
@@ -64,17 +93,30 @@ void Serializator::WriteBuses() {
           for (const auto& stop : bus->stop_names) {
               serialized_bus->add_index_stops(stop->id);
           }
+          for (const Trip& trip : bus->trips) {
+              serialized_bus->mutable_trip_times()->Add(trip.begin(), trip.end());
+          }
     }
+    return serialized_buses;
 }
 
-void Serializator::WriteDistances() {
-    const auto distances = catalogue_.GetDistance();
-    for (const auto& [stops, distance] : distances) {
-        proto_catalogue::Distance* serialized_distance = proto_catalogue_.add_distances();
+// The hash map has no stable order, so the distances are written sorted by
+// stop ids and the file does not depend on insertion history.
+google::protobuf::RepeatedPtrField<proto_catalogue::Distance> Serializator::WriteDistances() const {
+    const auto& distances = catalogue_.GetDistance();
+    std::vector<std::pair<PairStop, double>> sorted_distances(distances.begin(), distances.end());
+    std::sort(sorted_distances.begin(), sorted_distances.end(), [](const auto& lhs, const auto& rhs) {
+        return std::pair{lhs.first.first->id, lhs.first.second->id} < std::pair{rhs.first.first->id, rhs.first.second->id};
+    });
+    google::protobuf::RepeatedPtrField<proto_catalogue::Distance> serialized_distances;
+    serialized_distances.Reserve(static_cast<int>(sorted_distances.size()));
+    for (const auto& [stops, distance] : sorted_distances) {
+        proto_catalogue::Distance* serialized_distance = serialized_distances.Add();
         serialized_distance->set_id_stop_first(stops.first->name);
         serialized_distance->set_id_stop_second(stops.second->name);
         serialized_distance->set_distance(distance);
     }
+    return serialized_distances;
 }
 
 void Serializator::WriteMap() {
@@ -101,11 +143,73 @@ void Serializator::WriteRoutingSettings() {
     proto_catalogue::RoutingSettings* serialized_routing_settings = proto_catalogue_.mutable_routing_settings();
     serialized_routing_settings->set_bus_wait_time(routing_settings_.bus_wait_time_);
     serialized_routing_settings->set_bus_velocity(routing_settings_.bus_velocity_);
+    serialized_routing_settings->set_walking_velocity(routing_settings_.walking_velocity_);
+    serialized_routing_settings->set_max_walking_distance(routing_settings_.max_walking_distance_);
+    serialized_routing_settings->set_walking_stop_count(routing_settings_.walking_stop_count_);
+    serialized_routing_settings->set_max_transfers(routing_settings_.max_transfers_);
+    serialized_routing_settings->set_pareto_label_limit(routing_settings_.pareto_label_limit_);
+    serialized_routing_settings->set_alternative_work_limit(routing_settings_.alternative_work_limit_);
+    serialized_routing_settings->set_goal_directed_search(routing_settings_.goal_directed_search_);
+    serialized_routing_settings->set_implicit_edges(routing_settings_.implicit_edges_);
+    serialized_routing_settings->set_memory_budget_mb(routing_settings_.memory_budget_mb_);
 }
 
 void Serializator::ReadRoutingSettings() {
     router_.settings_.bus_wait_time_ = proto_catalogue_.routing_settings().bus_wait_time();
     router_.settings_.bus_velocity_ = proto_catalogue_.routing_settings().bus_velocity();
+    // Bases written before walking legs existed leave these unset; keep the defaults then.
+    if (proto_catalogue_.routing_settings().has_walking_velocity()) {
+        router_.settings_.walking_velocity_ = proto_catalogue_.routing_settings().walking_velocity();
+    }
+    if (proto_catalogue_.routing_settings().has_max_walking_distance()) {
+        router_.settings_.max_walking_distance_ = proto_catalogue_.routing_settings().max_walking_distance();
+    }
+    if (proto_catalogue_.routing_settings().has_walking_stop_count()) {
+        router_.settings_.walking_stop_count_ = static_cast<int>(proto_catalogue_.routing_settings().walking_stop_count());
+    }
+    if (proto_catalogue_.routing_settings().has_max_transfers()) {
+        router_.settings_.max_transfers_ = static_cast<int>(proto_catalogue_.routing_settings().max_transfers());
+    }
+    if (proto_catalogue_.routing_settings().has_pareto_label_limit()) {
+        router_.settings_.pareto_label_limit_ = static_cast<int>(proto_catalogue_.routing_settings().pareto_label_limit());
+    }
+    if (proto_catalogue_.routing_settings().has_alternative_work_limit()) {
+        router_.settings_.alternative_work_limit_ = static_cast<int>(proto_catalogue_.routing_settings().alternative_work_limit());
+    }
+    if (proto_catalogue_.routing_settings().has_goal_directed_search()) {
+        router_.settings_.goal_directed_search_ = proto_catalogue_.routing_settings().goal_directed_search();
+    }
+    if (proto_catalogue_.routing_settings().has_implicit_edges()) {
+        router_.settings_.implicit_edges_ = proto_catalogue_.routing_settings().implicit_edges();
+    }
+    if (proto_catalogue_.routing_settings().has_memory_budget_mb()) {
+        router_.settings_.memory_budget_mb_ = proto_catalogue_.routing_settings().memory_budget_mb();
+    }
+}
+
+void Serializator::WriteStopIndex() {
+    for (int stop_id : catalogue_.GetStopIndex().GetOrder()) {
+        proto_catalogue_.add_stop_index(stop_id);
+    }
+}
+
+void Serializator::ReadStopIndex() {
+    std::vector<int> order(proto_catalogue_.stop_index().begin(), proto_catalogue_.stop_index().end());
+    catalogue_.RestoreStopIndex(std::move(order));
+}
+
+void Serializator::WriteStopComponents() {
+    const graph::Components& components = catalogue_.GetStopComponents();
+    proto_catalogue_.mutable_strong_components()->Add(components.strong.begin(), components.strong.end());
+    proto_catalogue_.mutable_weak_components()->Add(components.weak.begin(), components.weak.end());
+}
+
+// Bases written before the components were stored get them recomputed.
+void Serializator::ReadStopComponents() {
+    graph::Components components{
+        {proto_catalogue_.strong_components().begin(), proto_catalogue_.strong_components().end()},
+        {proto_catalogue_.weak_components().begin(), proto_catalogue_.weak_components().end()}};
+    catalogue_.RestoreStopComponents(std::move(components));
 }
 
 proto_catalogue::Color Serializator::SerializeColor(const svg::Color &color) {
@@ -131,6 +235,10 @@ proto_catalogue::Color Serializator::SerializeColor(const svg::Color &color) {
 
 void Serializator::ReadStops() {
     for (const auto& stop : proto_catalogue_.stops()) {
+        if (stop.has_has_coord() && !stop.has_coord()) {
+            catalogue_.AddPlaceholderStop(stop.name());
+            continue;
+        }
         std::vector<std::pair<std::string, double>> id_;
         catalogue_.AddStop(stop.name(), stop.lat(), stop.lng(), id_);
     }
@@ -150,7 +258,13 @@ void Serializator::ReadBuses() {
         if (!bus.is_roundtrip()){
             type = RouteType::TWO_DIRECTIONAL;
         }
-        catalogue_.AddBusForSerializator(bus.name(), type, stop_names);
+        std::vector<Trip> trips;
+        if (const int stop_count = bus.index_stops_size(); stop_count > 0) {
+            for (int first = 0; first + stop_count <= bus.trip_times_size(); first += stop_count) {
+                trips.emplace_back(bus.trip_times().begin() + first, bus.trip_times().begin() + first + stop_count);
+            }
+        }
+        catalogue_.AddBusForSerializator(bus.name(), type, stop_names, std::move(trips));
     }
 }
 
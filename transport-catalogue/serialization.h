@@ -9,8 +9,15 @@ namespace serializator {
 
 using namespace transport_catalogue;
     
+// The order in which make_base numbers the stops of the base.
+enum class StopOrder {
+    INPUT,
+    HILBERT
+};
+
 struct SerializatorSettings {
     std::filesystem::path path;
+    StopOrder stop_order = StopOrder::INPUT;
 };
 
 class Serializator {
@@ -27,14 +34,16 @@ public:
 
     void Serialize();
 
-    void Deserialize();
+    bool Deserialize();
 
 private:
-    void WriteStops();
-    void WriteBuses();
-    void WriteDistances();
+    google::protobuf::RepeatedPtrField<proto_catalogue::Stop> WriteStops() const;
+    google::protobuf::RepeatedPtrField<proto_catalogue::Bus> WriteBuses() const;
+    google::protobuf::RepeatedPtrField<proto_catalogue::Distance> WriteDistances() const;
     void WriteMap();
     void WriteRoutingSettings();
+    void WriteStopIndex();
+    void WriteStopComponents();
     proto_catalogue::Color SerializeColor(const svg::Color& color);
     
     void ReadStops();
@@ -42,6 +51,8 @@ private:
     void ReadDistances();
     void ReadMap();
     void ReadRoutingSettings();
+    void ReadStopIndex();
+    void ReadStopComponents();
     svg::Color DeserializeColor(const proto_catalogue::Color &serialized_color);
     
     TransportCatalogue& catalogue_;
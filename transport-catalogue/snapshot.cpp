@@ -0,0 +1,51 @@
+#include "snapshot.h"
+#include "instrumentation.h"
+
+#include <sstream>
+
+using namespace std::literals;
+
+namespace server {
+
+std::shared_ptr<const CatalogueSnapshot> CatalogueSnapshot::Load(const serializator::SerializatorSettings& settings, ThreadPool& pool) {
+    instrumentation::ScopedTimer timer("server.load_snapshot"sv);
+    std::shared_ptr<CatalogueSnapshot> snapshot(new CatalogueSnapshot);
+    snapshot->catalogue_ = std::make_unique<TransportCatalogue>();
+    snapshot->router_ = std::make_unique<TransportRouter>();
+    snapshot->path_ = settings.path;
+    serializator::Serializator serializator(*snapshot->catalogue_, *snapshot->router_);
+    serializator.SetSetting(settings);
+    if (!serializator.Deserialize()) {
+        throw std::runtime_error("Failed to read base "s + settings.path.string());
+    }
+    snapshot->render_settings_ = serializator.GetRenderSettings();
+    // Route requests wait for the router; the map and everything else need not.
+    snapshot->router_->StartBuild(*snapshot->catalogue_, pool);
+    renderer::MapRenderer map_renderer(snapshot->render_settings_);
+    std::ostringstream map;
+    map_renderer.RenderSvgMap(*snapshot->catalogue_, map);
+    snapshot->rendered_map_ = std::make_shared<const std::string>(map.str());
+    return snapshot;
+}
+
+const TransportCatalogue& CatalogueSnapshot::GetCatalogue() const {
+    return *catalogue_;
+}
+
+const TransportRouter& CatalogueSnapshot::GetRouter() const {
+    return *router_;
+}
+
+const renderer::RenderSettings& CatalogueSnapshot::GetRenderSettings() const {
+    return render_settings_;
+}
+
+std::shared_ptr<const std::string> CatalogueSnapshot::GetRenderedMap() const {
+    return rendered_map_;
+}
+
+const std::filesystem::path& CatalogueSnapshot::GetPath() const {
+    return path_;
+}
+
+} // namespace server
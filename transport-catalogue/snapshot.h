@@ -0,0 +1,39 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "transport_router.h"
+#include "map_renderer.h"
+#include "serialization.h"
+
+namespace server {
+
+using namespace transport_catalogue;
+
+// Everything needed to answer stat requests for one base: the catalogue, the
+// router built over it and the rendered map. Only the router changes after
+// Load, in the background build Load starts, and Route requests wait for it;
+// so any number of threads may read it while a newer snapshot is being built.
+class CatalogueSnapshot {
+public:
+    // The router is built on pool, which has to outlive the snapshot.
+    static std::shared_ptr<const CatalogueSnapshot> Load(const serializator::SerializatorSettings& settings, ThreadPool& pool);
+
+    const TransportCatalogue& GetCatalogue() const;
+    const TransportRouter& GetRouter() const;
+    const renderer::RenderSettings& GetRenderSettings() const;
+    std::shared_ptr<const std::string> GetRenderedMap() const;
+    const std::filesystem::path& GetPath() const;
+
+private:
+    CatalogueSnapshot() = default;
+
+    std::unique_ptr<TransportCatalogue> catalogue_;
+    std::unique_ptr<TransportRouter> router_;
+    renderer::RenderSettings render_settings_;
+    std::shared_ptr<const std::string> rendered_map_;
+    std::filesystem::path path_;
+};
+
+using SnapshotPtr = std::shared_ptr<const CatalogueSnapshot>;
+
+} // namespace server
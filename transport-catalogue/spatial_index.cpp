@@ -0,0 +1,174 @@
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <queue>
+#include <tuple>
+
+namespace transport_catalogue {
+
+void StopIndex::Build(const geo::UnitSphereArray& points, std::vector<int> stop_ids) {
+    order_ = std::move(stop_ids);
+    BuildRange(points, 0, order_.size(), 0);
+    FillPoints(points);
+}
+
+bool StopIndex::Restore(const geo::UnitSphereArray& points, const std::vector<int>& stop_ids, std::vector<int> order) {
+    if (order.size() != stop_ids.size()) {
+        return false;
+    }
+    std::vector<bool> expected(points.Size(), false);
+    for (int stop_id : stop_ids) {
+        if (stop_id < 0 || static_cast<size_t>(stop_id) >= expected.size()) {
+            return false;
+        }
+        expected[stop_id] = true;
+    }
+    for (int stop_id : order) {
+        if (stop_id < 0 || static_cast<size_t>(stop_id) >= expected.size() || !expected[stop_id]) {
+            return false;
+        }
+        expected[stop_id] = false;
+    }
+    if (!IsValidRange(points, order, 0, order.size(), 0)) {
+        return false;
+    }
+    order_ = std::move(order);
+    FillPoints(points);
+    return true;
+}
+
+const std::vector<int>& StopIndex::GetOrder() const {
+    return order_;
+}
+
+size_t StopIndex::Size() const {
+    return order_.size();
+}
+
+template <typename Visitor>
+void StopIndex::Visit(size_t begin, size_t end, int axis, const Point& center, double& bound, Visitor& visitor) const {
+    if (begin >= end) {
+        return;
+    }
+    const size_t middle = begin + (end - begin) / 2;
+    const Point& point = points_[middle];
+    visitor(middle, SquaredChord(center, point), bound);
+    const double diff = GetAxis(center, axis) - GetAxis(point, axis);
+    const int next_axis = (axis + 1) % 3;
+    if (diff < 0) {
+        Visit(begin, middle, next_axis, center, bound, visitor);
+        if (diff * diff <= bound) {
+            Visit(middle + 1, end, next_axis, center, bound, visitor);
+        }
+    } else {
+        Visit(middle + 1, end, next_axis, center, bound, visitor);
+        if (diff * diff <= bound) {
+            Visit(begin, middle, next_axis, center, bound, visitor);
+        }
+    }
+}
+
+std::vector<StopIndex::Neighbour> StopIndex::FindInRadius(geo::Coordinates center, double radius) const {
+    std::vector<Neighbour> result;
+    if (radius < 0) {
+        return result;
+    }
+    const double angle = std::min(radius / geo::EARTH_RADIUS, 3.1415926535);
+    const double chord = 2 * std::sin(angle / 2);
+    double bound = chord * chord;
+    auto collect = [&result, this](size_t index, double squared_chord, double& bound) {
+        if (squared_chord <= bound) {
+            result.push_back({order_[index], geo::UnitSphereArray::ChordToDistance(std::sqrt(squared_chord))});
+        }
+    };
+    Visit(0, order_.size(), 0, geo::ToUnitVector(center), bound, collect);
+    std::sort(result.begin(), result.end(), [](const Neighbour& lhs, const Neighbour& rhs) {
+        return std::tie(lhs.distance, lhs.stop_id) < std::tie(rhs.distance, rhs.stop_id);
+    });
+    return result;
+}
+
+std::vector<StopIndex::Neighbour> StopIndex::FindNearest(geo::Coordinates center, size_t count) const {
+    std::vector<Neighbour> result;
+    if (count == 0) {
+        return result;
+    }
+    std::priority_queue<std::pair<double, int>> best;
+    double bound = 4.0 + 1e-9;
+    auto collect = [&best, count, this](size_t index, double squared_chord, double& bound) {
+        if (best.size() < count) {
+            best.push({squared_chord, order_[index]});
+        } else if (squared_chord < best.top().first) {
+              best.pop();
+              best.push({squared_chord, order_[index]});
+          }
+        if (best.size() == count) {
+            bound = best.top().first;
+        }
+    };
+    Visit(0, order_.size(), 0, geo::ToUnitVector(center), bound, collect);
+    result.reserve(best.size());
+    for (; !best.empty(); best.pop()) {
+        result.push_back({best.top().second, geo::UnitSphereArray::ChordToDistance(std::sqrt(best.top().first))});
+    }
+    std::sort(result.begin(), result.end(), [](const Neighbour& lhs, const Neighbour& rhs) {
+        return std::tie(lhs.distance, lhs.stop_id) < std::tie(rhs.distance, rhs.stop_id);
+    });
+    return result;
+}
+
+void StopIndex::BuildRange(const geo::UnitSphereArray& points, size_t begin, size_t end, int axis) {
+    if (end - begin < 2) {
+        return;
+    }
+    const size_t middle = begin + (end - begin) / 2;
+    std::nth_element(order_.begin() + begin, order_.begin() + middle, order_.begin() + end,
+                     [&points, axis](int lhs, int rhs) {
+        return IsLess(points, lhs, rhs, axis);
+    });
+    BuildRange(points, begin, middle, (axis + 1) % 3);
+    BuildRange(points, middle + 1, end, (axis + 1) % 3);
+}
+
+// Every stop left of a split precedes its middle stop on the split axis, and
+// every stop right of it follows, as BuildRange leaves them.
+bool StopIndex::IsValidRange(const geo::UnitSphereArray& points, const std::vector<int>& order, size_t begin, size_t end, int axis) {
+    if (end - begin < 2) {
+        return true;
+    }
+    const size_t middle = begin + (end - begin) / 2;
+    for (size_t i = begin; i < end; ++i) {
+        if ((i < middle && !IsLess(points, order[i], order[middle], axis))
+            || (i > middle && !IsLess(points, order[middle], order[i], axis))) {
+            return false;
+        }
+    }
+    return IsValidRange(points, order, begin, middle, (axis + 1) % 3)
+        && IsValidRange(points, order, middle + 1, end, (axis + 1) % 3);
+}
+
+bool StopIndex::IsLess(const geo::UnitSphereArray& points, int lhs, int rhs, int axis) {
+    const double lhs_value = axis == 0 ? points.X(lhs) : axis == 1 ? points.Y(lhs) : points.Z(lhs);
+    const double rhs_value = axis == 0 ? points.X(rhs) : axis == 1 ? points.Y(rhs) : points.Z(rhs);
+    return std::tie(lhs_value, lhs) < std::tie(rhs_value, rhs);
+}
+
+void StopIndex::FillPoints(const geo::UnitSphereArray& points) {
+    points_.resize(order_.size());
+    for (size_t i = 0; i < order_.size(); ++i) {
+        points_[i] = {points.X(order_[i]), points.Y(order_[i]), points.Z(order_[i])};
+    }
+}
+
+double StopIndex::GetAxis(const Point& point, int axis) {
+    return axis == 0 ? point.x : axis == 1 ? point.y : point.z;
+}
+
+double StopIndex::SquaredChord(const Point& lhs, const Point& rhs) {
+    const double dx = lhs.x - rhs.x;
+    const double dy = lhs.y - rhs.y;
+    const double dz = lhs.z - rhs.z;
+    return dx * dx + dy * dy + dz * dz;
+}
+
+} // namespace transport_catalogue
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "geo.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace transport_catalogue {
+
+// Static 3-d tree over stop points on the unit sphere. Straight-line (chord) distance
+// between unit vectors grows monotonically with great-circle distance, so radius and
+// nearest-neighbour searches run on plain Euclidean boxes.
+class StopIndex {
+public:
+    struct Neighbour {
+        int stop_id = 0;
+        double distance = 0;
+    };
+
+    void Build(const geo::UnitSphereArray& points, std::vector<int> stop_ids);
+    // Reuses a tree order produced by Build over stop_ids, e.g. one read from
+    // the serialized base. Returns false, leaving the index as it was, unless
+    // order holds exactly stop_ids and satisfies every split of the tree.
+    bool Restore(const geo::UnitSphereArray& points, const std::vector<int>& stop_ids, std::vector<int> order);
+    const std::vector<int>& GetOrder() const;
+    size_t Size() const;
+
+    std::vector<Neighbour> FindInRadius(geo::Coordinates center, double radius) const;
+    std::vector<Neighbour> FindNearest(geo::Coordinates center, size_t count) const;
+
+private:
+    using Point = geo::UnitVector;
+
+    void BuildRange(const geo::UnitSphereArray& points, size_t begin, size_t end, int axis);
+    static bool IsValidRange(const geo::UnitSphereArray& points, const std::vector<int>& order, size_t begin, size_t end, int axis);
+    static bool IsLess(const geo::UnitSphereArray& points, int lhs, int rhs, int axis);
+    void FillPoints(const geo::UnitSphereArray& points);
+    static double GetAxis(const Point& point, int axis);
+    static double SquaredChord(const Point& lhs, const Point& rhs);
+
+    template <typename Visitor>
+    void Visit(size_t begin, size_t end, int axis, const Point& center, double& bound, Visitor& visitor) const;
+
+    std::vector<int> order_;
+    std::vector<Point> points_;
+};
+
+} // namespace transport_catalogue
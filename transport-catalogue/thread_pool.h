@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace transport_catalogue {
+
+// Fixed set of worker threads taking tasks from a shared queue.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t thread_count);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    template <typename Function>
+    auto Submit(Function function) -> std::future<decltype(function())>;
+
+    // Calls function(begin, end) on about one chunk of [0, size) per worker and
+    // waits for all of them; an exception from any chunk is rethrown here.
+    // Must not be called from a task running on the same pool.
+    template <typename Function>
+    void ParallelFor(size_t size, Function function);
+
+    size_t GetThreadCount() const;
+
+private:
+    void Work();
+
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable has_task_;
+    bool stopping_ = false;
+};
+
+template <typename Function>
+auto ThreadPool::Submit(Function function) -> std::future<decltype(function())> {
+    using Result = decltype(function());
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+    std::future<Result> result = task->get_future();
+    {
+        std::lock_guard guard(mutex_);
+        tasks_.push([task]() {
+            (*task)();
+        });
+    }
+    has_task_.notify_one();
+    return result;
+}
+
+template <typename Function>
+void ThreadPool::ParallelFor(size_t size, Function function) {
+    const size_t chunk_count = std::min(size, GetThreadCount());
+    std::vector<std::future<void>> chunks;
+    chunks.reserve(chunk_count);
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        const size_t begin = size * chunk / chunk_count;
+        const size_t end = size * (chunk + 1) / chunk_count;
+        chunks.push_back(Submit([&function, begin, end]() {
+            function(begin, end);
+        }));
+    }
+    // Every chunk has to end before function and what it refers to go out of
+    // scope, so the first exception is only rethrown once all are done.
+    std::exception_ptr error;
+    for (std::future<void>& chunk : chunks) {
+        try {
+            chunk.get();
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace transport_catalogue
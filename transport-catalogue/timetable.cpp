@@ -0,0 +1,205 @@
+#include "timetable.h"
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+using namespace std::literals;
+
+namespace transport_catalogue {
+
+void Timetable::Build(const TransportCatalogue& catalogue) {
+    instrumentation::ScopedTimer timer("router.timetable"sv);
+    *this = Timetable{};
+    stop_count_ = catalogue.GetAllStops().size();
+    const std::deque<Bus>& buses = catalogue.GetAllBuses();
+    std::vector<size_t> stop_route_counts(stop_count_ + 1, 0);
+    for (size_t bus_index = 0; bus_index < buses.size(); ++bus_index) {
+        const Bus& bus = buses[bus_index];
+        if (bus.trips.empty() || bus.stop_names.empty()) {
+            continue;
+        }
+        std::vector<size_t> trip_order(bus.trips.size());
+        std::iota(trip_order.begin(), trip_order.end(), 0);
+        std::stable_sort(trip_order.begin(), trip_order.end(), [&bus](size_t lhs, size_t rhs) {
+            return bus.trips[lhs].front() < bus.trips[rhs].front();
+        });
+        // Trips that overtake each other go to separate routes, so that the
+        // order by departure holds at every stop of a route.
+        std::vector<std::vector<size_t>> route_trips;
+        for (size_t trip : trip_order) {
+            auto fits = [&bus, trip](const std::vector<size_t>& trips) {
+                const Trip& last = bus.trips[trips.back()];
+                for (size_t position = 0; position < last.size(); ++position) {
+                    if (bus.trips[trip][position] < last[position]) {
+                        return false;
+                    }
+                }
+                return true;
+            };
+            if (const auto it = std::find_if(route_trips.begin(), route_trips.end(), fits); it != route_trips.end()) {
+                it->push_back(trip);
+            } else {
+                  route_trips.push_back({trip});
+              }
+        }
+        for (const std::vector<size_t>& trips : route_trips) {
+            Route route;
+            route.bus = bus_index;
+            route.first_stop = route_stops_.size();
+            route.stop_count = bus.stop_names.size();
+            route.first_time = stop_times_.size();
+            route.trip_count = trips.size();
+            for (const Stop* stop : bus.stop_names) {
+                route_stops_.push_back(static_cast<uint32_t>(stop->id));
+                ++stop_route_counts[stop->id + 1];
+            }
+            for (size_t trip : trips) {
+                stop_times_.insert(stop_times_.end(), bus.trips[trip].begin(), bus.trips[trip].end());
+            }
+            routes_.push_back(route);
+        }
+    }
+    stop_route_offsets_.assign(stop_count_ + 1, 0);
+    std::partial_sum(stop_route_counts.begin(), stop_route_counts.end(), stop_route_offsets_.begin());
+    stop_routes_.resize(stop_route_offsets_.back());
+    std::vector<size_t> next(stop_route_offsets_.begin(), stop_route_offsets_.end() - 1);
+    for (size_t route = 0; route < routes_.size(); ++route) {
+        for (size_t position = 0; position < routes_[route].stop_count; ++position) {
+            const uint32_t stop = route_stops_[routes_[route].first_stop + position];
+            stop_routes_[next[stop]++] = {static_cast<uint32_t>(route), static_cast<uint32_t>(position)};
+        }
+    }
+    instrumentation::AddCounter("timetable.trips"sv, static_cast<int64_t>(GetTripCount()));
+}
+
+bool Timetable::IsEmpty() const {
+    return routes_.empty();
+}
+
+size_t Timetable::GetTripCount() const {
+    size_t trip_count = 0;
+    for (const Route& route : routes_) {
+        trip_count += route.trip_count;
+    }
+    return trip_count;
+}
+
+std::optional<size_t> Timetable::FindEarliestTrip(const Route& route, size_t position, double time) const {
+    size_t low = 0;
+    size_t high = route.trip_count;
+    while (low < high) {
+        const size_t middle = (low + high) / 2;
+        if (GetTime(route, middle, position) < time) {
+            low = middle + 1;
+        } else {
+              high = middle;
+          }
+    }
+    return low < route.trip_count ? std::optional<size_t>{low} : std::nullopt;
+}
+
+std::optional<Timetable::Journey> Timetable::FindEarliestArrival(size_t from_stop, size_t to_stop, double departure_time, int max_rounds) const {
+    if (from_stop >= stop_count_ || to_stop >= stop_count_) {
+        return std::nullopt;
+    }
+    if (from_stop == to_stop) {
+        return Journey{departure_time, {}};
+    }
+    constexpr double INF = std::numeric_limits<double>::infinity();
+    const size_t round_count = static_cast<size_t>(std::max(max_rounds, 0)) + 1;
+    // Round k holds the best arrival using at most k trips.
+    std::vector<double> arrivals(round_count * stop_count_, INF);
+    std::vector<Parent> parents(round_count * stop_count_);
+    std::vector<double> best(stop_count_, INF);
+    std::vector<uint32_t> marked{static_cast<uint32_t>(from_stop)};
+    std::vector<bool> is_marked(stop_count_, false);
+    std::vector<uint32_t> queue_position(routes_.size(), UINT32_MAX);
+    std::vector<uint32_t> queued_routes;
+    arrivals[from_stop] = departure_time;
+    best[from_stop] = departure_time;
+    size_t scanned_routes = 0;
+
+    for (size_t round = 1; round < round_count && !marked.empty(); ++round) {
+        double* previous = &arrivals[(round - 1) * stop_count_];
+        double* current = &arrivals[round * stop_count_];
+        Parent* round_parents = &parents[round * stop_count_];
+        std::copy(previous, previous + stop_count_, current);
+
+        for (uint32_t stop : marked) {
+            is_marked[stop] = false;
+            for (size_t i = stop_route_offsets_[stop]; i < stop_route_offsets_[stop + 1]; ++i) {
+                const auto [route, position] = stop_routes_[i];
+                if (queue_position[route] == UINT32_MAX) {
+                    queued_routes.push_back(route);
+                    queue_position[route] = position;
+                } else {
+                      queue_position[route] = std::min(queue_position[route], position);
+                  }
+            }
+        }
+        marked.clear();
+
+        for (uint32_t route_index : queued_routes) {
+            const Route& route = routes_[route_index];
+            ++scanned_routes;
+            std::optional<size_t> trip;
+            size_t board = 0;
+            for (size_t position = queue_position[route_index]; position < route.stop_count; ++position) {
+                const uint32_t stop = route_stops_[route.first_stop + position];
+                if (trip) {
+                    const double time = GetTime(route, *trip, position);
+                    if (time < std::min(best[stop], best[to_stop])) {
+                        current[stop] = time;
+                        best[stop] = time;
+                        round_parents[stop] = {route_index, static_cast<uint32_t>(*trip), static_cast<uint32_t>(board), static_cast<uint32_t>(position)};
+                        if (!is_marked[stop]) {
+                            is_marked[stop] = true;
+                            marked.push_back(stop);
+                        }
+                    }
+                }
+                // Switch to an earlier trip if the previous round reaches this stop in time for it.
+                if (previous[stop] < INF && (!trip || previous[stop] <= GetTime(route, *trip, position))) {
+                    if (const auto earlier = FindEarliestTrip(route, position, previous[stop]); earlier && (!trip || *earlier < *trip)) {
+                        trip = earlier;
+                        board = position;
+                    }
+                }
+            }
+            queue_position[route_index] = UINT32_MAX;
+        }
+        queued_routes.clear();
+    }
+    instrumentation::AddCounter("timetable.queries"sv);
+    instrumentation::AddCounter("timetable.scanned_routes"sv, static_cast<int64_t>(scanned_routes));
+
+    if (best[to_stop] == INF) {
+        return std::nullopt;
+    }
+    size_t round = 1;
+    while (arrivals[round * stop_count_ + to_stop] != best[to_stop]) {
+        ++round;
+    }
+    Journey journey;
+    journey.arrival = best[to_stop];
+    size_t stop = to_stop;
+    while (stop != from_stop) {
+        while (round > 0 && parents[round * stop_count_ + stop].route == NO_ROUTE) {
+            --round;
+        }
+        if (round == 0) {
+            return std::nullopt;
+        }
+        const Parent& parent = parents[round * stop_count_ + stop];
+        const Route& route = routes_[parent.route];
+        journey.legs.push_back({route.bus, parent.board, parent.alight, GetTime(route, parent.trip, parent.board), GetTime(route, parent.trip, parent.alight)});
+        stop = route_stops_[route.first_stop + parent.board];
+        --round;
+    }
+    std::reverse(journey.legs.begin(), journey.legs.end());
+    return journey;
+}
+
+} // namespace transport_catalogue
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "transport_catalogue.h"
+
+#include <cstdint>
+
+namespace transport_catalogue {
+
+// Trips of the buses that have a timetable, laid out for round-based
+// routing (RAPTOR, Delling et al.): every bus is a route with its stop
+// sequence and a trips x stops array of times, trips sorted by departure.
+// Times are minutes from midnight. A bus whose trips overtake each other is
+// split into several routes, so the order holds at every stop of a route.
+class Timetable {
+public:
+    struct Leg {
+        size_t bus = 0;
+        size_t board = 0;
+        size_t alight = 0;
+        double departure = 0;
+        double arrival = 0;
+    };
+
+    struct Journey {
+        double arrival = 0;
+        std::vector<Leg> legs;
+    };
+
+    void Build(const TransportCatalogue& catalogue);
+    bool IsEmpty() const;
+    size_t GetTripCount() const;
+
+    // Earliest arrival at to_stop leaving from_stop not before departure_time,
+    // using at most max_rounds trips; among equally early journeys the one
+    // with fewer trips wins. Positions in legs index the bus stop list.
+    std::optional<Journey> FindEarliestArrival(size_t from_stop, size_t to_stop, double departure_time, int max_rounds) const;
+
+private:
+    struct Route {
+        size_t bus = 0;
+        size_t first_stop = 0;
+        size_t stop_count = 0;
+        size_t first_time = 0;
+        size_t trip_count = 0;
+    };
+
+    // Set for a stop in the round in which a trip improved its arrival.
+    struct Parent {
+        uint32_t route = NO_ROUTE;
+        uint32_t trip = 0;
+        uint32_t board = 0;
+        uint32_t alight = 0;
+    };
+
+    static constexpr uint32_t NO_ROUTE = UINT32_MAX;
+
+    double GetTime(const Route& route, size_t trip, size_t position) const {
+        return stop_times_[route.first_time + trip * route.stop_count + position];
+    }
+
+    std::optional<size_t> FindEarliestTrip(const Route& route, size_t position, double time) const;
+
+    std::vector<Route> routes_;
+    std::vector<uint32_t> route_stops_;
+    std::vector<double> stop_times_;
+    // Routes through every stop with the position of the stop on them.
+    std::vector<size_t> stop_route_offsets_;
+    std::vector<std::pair<uint32_t, uint32_t>> stop_routes_;
+    size_t stop_count_ = 0;
+};
+
+} // namespace transport_catalogue
@@ -3,18 +3,48 @@
 namespace transport_catalogue {
 
 void TransportCatalogue::AddBus(const QueryInputBus& query) {
+    AddBus(MakeBus(query));
+}
+
+Bus TransportCatalogue::MakeBus(const QueryInputBus& query) const {
     Bus bus;
     bus.type = query.type;
     bus.name_bus = query.name;
+    bus.trips = query.trips;
     for (const std::string& st : query.stops_list) {
-        Stop* that_stop = FindStop(st);
-        bus.stop_names.push_back(that_stop);
+        const auto stop_i = map_all_stops.find(st);
+        bus.stop_names.push_back(stop_i != map_all_stops.end() ? stop_i->second : nullptr);
     }
     if (bus.type == RouteType::TWO_DIRECTIONAL) {
         for (int i = static_cast<int>(bus.stop_names.size()-2); i >= 0; --i){
             bus.stop_names.push_back(bus.stop_names[i]);
         }
     }
+    FillRouteDistances(bus);
+    return bus;
+}
+
+// Needs every distance and stop coordinate of the route to be known already.
+void TransportCatalogue::FillRouteDistances(Bus& bus) const {
+    bus.road_prefix.assign(bus.stop_names.size(), 0.);
+    bus.geo_prefix.assign(bus.stop_names.size(), 0.);
+    for (size_t i = 1; i < bus.stop_names.size(); ++i) {
+        const Stop* from = bus.stop_names[i - 1];
+        const Stop* to = bus.stop_names[i];
+        double road = 0;
+        double straight = 0;
+        if (from && to) {
+            road = GetCalculateDistance(from, to);
+            if (static_cast<size_t>(std::max(from->id, to->id)) < stop_points_.Size()) {
+                straight = stop_points_.ComputeDistance(from->id, to->id);
+            }
+        }
+        bus.road_prefix[i] = bus.road_prefix[i - 1] + road;
+        bus.geo_prefix[i] = bus.geo_prefix[i - 1] + straight;
+    }
+}
+
+void TransportCatalogue::AddBus(Bus bus) {
     buses.push_back(std::move(bus));
     map_all_buses[buses.back().name_bus] = &buses.back();
 
@@ -26,15 +56,17 @@ void TransportCatalogue::AddBus(const QueryInputBus& query) {
 void TransportCatalogue::AddStop(std::string_view stop_name, const double lat, const double lng,
 const std::vector<std::pair<std::string, double>>& id_){
     if (!map_all_stops.count(stop_name)) {
-        Stop the_stop{std::string{stop_name}, lat, lng, id}; 
+        Stop the_stop{std::string{stop_name}, {lat, lng}, id, true};
         stops.push_back(std::move(the_stop));
         map_all_stops[stops.back().name] = &stops.back();
         ++id;
     } else {
           map_all_stops[stop_name] -> coord.lat = lat;
           map_all_stops[stop_name] -> coord.lng = lng;
+          map_all_stops[stop_name] -> has_coord = true;
       }
       Stop* st1 = map_all_stops[stop_name];
+      stop_points_.Set(st1->id, st1->coord);
       if (!id_.empty()) {
           for (auto& [key, value] : id_){
               if (map_all_stops.count(key)){
@@ -42,26 +74,38 @@ const std::vector<std::pair<std::string, double>>& id_){
                 st2 = map_all_stops[key];
                 map_distance_to_stop[{st1, st2}] = value;
               } else {
-                    Stop st2;
-                    st2.id = id;
-                    ++ id;
-                    st2.name = key;
-                    stops.push_back(std::move(st2));
-                    map_all_stops[stops.back().name] = &stops.back();
+                    AddPlaceholderStop(key);
                     map_distance_to_stop[{st1, &stops.back()}] = value;
                 }
           }
       }
 }
     
-void TransportCatalogue::AddBusForSerializator(std::string bus_name, RouteType type, std::vector<std::string> stop_names){
+void TransportCatalogue::AddPlaceholderStop(std::string_view stop_name) {
+    if (map_all_stops.count(stop_name)) {
+        return;
+    }
+    Stop stop;
+    stop.id = id;
+    ++ id;
+    stop.name = std::string{stop_name};
+    stops.push_back(std::move(stop));
+    map_all_stops[stops.back().name] = &stops.back();
+    // Placeholder stops get points too, so that the array is never resized
+    // once buses start reading it.
+    stop_points_.Resize(stops.size());
+}
+
+void TransportCatalogue::AddBusForSerializator(std::string bus_name, RouteType type, std::vector<std::string> stop_names, std::vector<Trip> trips){
     Bus bus;
     bus.type = type;
     bus.name_bus = bus_name;
+    bus.trips = std::move(trips);
     for (auto stop : stop_names) {
         Stop* that_stop = FindStop(stop);
         bus.stop_names.push_back(that_stop);
     }
+    FillRouteDistances(bus);
     buses.push_back(std::move(bus));
     map_all_buses[buses.back().name_bus] = &buses.back();
     for (const Stop* stop : map_all_buses[buses.back().name_bus]->stop_names) {
@@ -77,37 +121,29 @@ const std::unordered_map<PairStop, double, DistanceHasher> &TransportCatalogue::
     return map_distance_to_stop;
 }
     
-double TransportCatalogue::GetCalculateDistance(const Stop* first_route, const Stop* second_route) {
-    if (map_distance_to_stop.count({first_route, second_route}) != 0) {
-        return (map_distance_to_stop[{first_route, second_route}]);
-    } else {
-          return (map_distance_to_stop[{second_route, first_route}]);
-      }
+double TransportCatalogue::GetCalculateDistance(const Stop* first_route, const Stop* second_route) const {
+    if (const auto it = map_distance_to_stop.find({first_route, second_route}); it != map_distance_to_stop.end()) {
+        return it->second;
+    }
+    const auto it = map_distance_to_stop.find({second_route, first_route});
+    return it != map_distance_to_stop.end() ? it->second : 0.;
 }
     
 BusQueryInput TransportCatalogue::GetBusInfo(const Bus& bus) const {
     std::set<std::string> buffer_names;
     int stops_count = bus.stop_names.size();
-    double length = 0;
-    double route_length = 0;
     for (size_t i = 1; i < bus.stop_names.size(); ++i){
-        Stop* st1 = bus.stop_names[i-1];
-        Stop* st2 = bus.stop_names[i];
-        buffer_names.insert(st1 ->name);
-        if (map_distance_to_stop.count({st1, st2})){
-            route_length += map_distance_to_stop.at({st1, st2});
-        } else {
-              route_length += map_distance_to_stop.at({st2, st1});
-          }
-          length += ComputeDistance(bus.stop_names[i-1] -> coord, bus.stop_names[i] -> coord);
+        buffer_names.insert(bus.stop_names[i - 1]->name);
     }
+    double route_length = bus.road_prefix.empty() ? 0. : bus.road_prefix.back();
+    double length = bus.geo_prefix.empty() ? 0. : bus.geo_prefix.back();
     double curvature = route_length / length;
     int unique_stops_count = buffer_names.size();
     BusQueryInput bus_info{bus.name_bus, stops_count, unique_stops_count, route_length, curvature};
     return bus_info;
 }
     
-std::optional<std::set<std::string>> TransportCatalogue::GetStopInfo(std::string_view query) {
+std::optional<std::set<std::string>> TransportCatalogue::GetStopInfo(std::string_view query) const {
     std::set<std::string> buses_at_stop;
     if (!map_all_stops.count(query)){
         return std::nullopt;
@@ -125,11 +161,19 @@ std::optional<std::set<std::string>> TransportCatalogue::GetStopInfo(std::string
 Stop* TransportCatalogue::FindStop(const std::string_view stop_name) {
     return map_all_stops.count(stop_name) ? map_all_stops.at(stop_name) : nullptr;
 }
+
+const Stop* TransportCatalogue::FindStop(const std::string_view stop_name) const {
+    return map_all_stops.count(stop_name) ? map_all_stops.at(stop_name) : nullptr;
+}
     
 Bus* TransportCatalogue::FindBus(std::string_view bus_name) {
     return map_all_buses.count(bus_name) ? map_all_buses.at(bus_name) : nullptr;
 }
 
+const Bus* TransportCatalogue::FindBus(std::string_view bus_name) const {
+    return map_all_buses.count(bus_name) ? map_all_buses.at(bus_name) : nullptr;
+}
+
 const std::map<std::string_view, const Bus*> TransportCatalogue::GetBuses() const {
     std::map<std::string_view, const Bus*>  result(map_all_buses.begin(), map_all_buses.end());
     return result;
@@ -155,5 +199,66 @@ const std::deque<Bus>& TransportCatalogue::GetAllBuses() const {
 const std::deque<Stop>& TransportCatalogue::GetAllStops() const {
 	return stops;
 }
+
+const Stop* TransportCatalogue::FindStopById(int stop_id) const {
+    if (stop_id < 0 || static_cast<size_t>(stop_id) >= stops.size()) {
+        return nullptr;
+    }
+    return &stops[stop_id];
+}
+
+const geo::UnitSphereArray& TransportCatalogue::GetStopPoints() const {
+    return stop_points_;
+}
+
+// Placeholder stops have no position, so they stay out of the index.
+std::vector<int> TransportCatalogue::GetIndexedStopIds() const {
+    std::vector<int> stop_ids;
+    stop_ids.reserve(stops.size());
+    for (const Stop& stop : stops) {
+        if (stop.has_coord) {
+            stop_ids.push_back(stop.id);
+        }
+    }
+    return stop_ids;
+}
+
+void TransportCatalogue::BuildStopIndex() {
+    stop_index_.Build(stop_points_, GetIndexedStopIds());
+}
+
+void TransportCatalogue::RestoreStopIndex(std::vector<int> order) {
+    if (!stop_index_.Restore(stop_points_, GetIndexedStopIds(), std::move(order))) {
+        BuildStopIndex();
+    }
+}
+
+const StopIndex& TransportCatalogue::GetStopIndex() const {
+    return stop_index_;
+}
+
+// A bus rides between any two of its stops in order, which is exactly what
+// its consecutive arcs reach, so this graph connects what the router does.
+void TransportCatalogue::BuildStopComponents() {
+    std::vector<graph::Edge<double>> arcs;
+    for (const Bus& bus : buses) {
+        for (size_t i = 1; i < bus.stop_names.size(); ++i) {
+            arcs.push_back({static_cast<graph::VertexId>(bus.stop_names[i - 1]->id), static_cast<graph::VertexId>(bus.stop_names[i]->id), 0.});
+        }
+    }
+    stop_components_ = graph::ComputeComponents(graph::DirectedWeightedGraph<double>(stops.size(), std::move(arcs)));
+}
+
+void TransportCatalogue::RestoreStopComponents(graph::Components components) {
+    if (components.strong.size() != stops.size() || components.weak.size() != stops.size()) {
+        BuildStopComponents();
+        return;
+    }
+    stop_components_ = std::move(components);
+}
+
+const graph::Components& TransportCatalogue::GetStopComponents() const {
+    return stop_components_;
+}
     
 } // namespace transport_catalogue;
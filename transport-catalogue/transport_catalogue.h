@@ -2,6 +2,8 @@
 
 #include "geo.h"
 #include "domain.h"
+#include "spatial_index.h"
+#include "graph_components.h"
 
 namespace transport_catalogue {
 
@@ -17,22 +19,42 @@ class TransportCatalogue {
 
 public:  
     void AddStop(std::string_view stop_name, const double lat, const double lng, const std::vector<std::pair<std::string, double>>& dst_info);
+    // A stop named before its own request; it gets coordinates from AddStop later, if ever.
+    void AddPlaceholderStop(std::string_view stop_name);
     void AddBus(const QueryInputBus& query);
+    // Resolves the stop names of a bus without touching the catalogue, so
+    // buses can be prepared concurrently once all their stops are added.
+    Bus MakeBus(const QueryInputBus& query) const;
+    void AddBus(Bus bus);
     void SetDistance(std::string_view stop_from, std::string_view stop_to, size_t distance);
     const std::unordered_map<PairStop, double, DistanceHasher>& GetDistance() const;
     BusQueryInput GetBusInfo(const Bus& bus) const;
-    std::optional<std::set<std::string>> GetStopInfo(std::string_view query);
+    std::optional<std::set<std::string>> GetStopInfo(std::string_view query) const;
     Bus* FindBus(std::string_view bus_name);
+    const Bus* FindBus(std::string_view bus_name) const;
     Stop* FindStop(const std::string_view stop_name);
+    const Stop* FindStop(const std::string_view stop_name) const;
     const std::deque<Bus>& GetAllBuses() const;
 	const std::deque<Stop>& GetAllStops() const;
-    void AddBusForSerializator(std::string bus_name, RouteType type, std::vector<std::string> stop_names);
+    void AddBusForSerializator(std::string bus_name, RouteType type, std::vector<std::string> stop_names, std::vector<Trip> trips = {});
     const std::map<std::string_view, const Bus*> GetBuses() const;
     const std::map<std::string_view, const Stop*> GetStops() const;
     const std::set<std::string_view>& GetBusesForStop(std::string_view stop) const;
-    double GetCalculateDistance(const Stop* first_route, const Stop* second_route);
+    double GetCalculateDistance(const Stop* first_route, const Stop* second_route) const;
+    const Stop* FindStopById(int stop_id) const;
+    const geo::UnitSphereArray& GetStopPoints() const;
+    void BuildStopIndex();
+    void RestoreStopIndex(std::vector<int> order);
+    const StopIndex& GetStopIndex() const;
+    // Components of the stop graph whose arcs join consecutive stops of a bus.
+    void BuildStopComponents();
+    void RestoreStopComponents(graph::Components components);
+    const graph::Components& GetStopComponents() const;
     
 private: 
+    void FillRouteDistances(Bus& bus) const;
+    std::vector<int> GetIndexedStopIds() const;
+
     int id = 0;
     const std::set<std::string_view> empty_route{};
     std::deque<Stop> stops;
@@ -41,6 +63,9 @@ private:
     std::unordered_map<std::string_view, Bus*> map_all_buses;
     std::unordered_map<PairStop, double, DistanceHasher> map_distance_to_stop;
     std::unordered_map<std::string_view, std::set<std::string_view>> stop_to_bus_map; 
+    geo::UnitSphereArray stop_points_;
+    StopIndex stop_index_;
+    graph::Components stop_components_;
     
 }; //TransportCatalogue
 }  //transport_catalogue
@@ -1,50 +1,719 @@
 #include "transport_router.h"
+#include "instrumentation.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <tuple>
 
 namespace transport_catalogue {
 
-void TransportRouter::CreateGraph(TransportCatalogue& catalogue) {
-    graph::DirectedWeightedGraph<double> graph(catalogue.GetStops().size());
-    id_for_stops.resize(catalogue.GetStops().size());
-    for(const Bus& bus : catalogue.GetAllBuses()) {
-        for (auto it_from = bus.stop_names.begin(); it_from != bus.stop_names.end(); ++it_from) {
-            const Stop* stop_from = *it_from;
-            double length = 0;
-            const Stop* prev_stop = stop_from;
-            id_for_stops[stop_from->id] = stop_from->name;
-            for (auto it_to = std::next(it_from); it_to != bus.stop_names.end(); ++it_to) {
-                const Stop* stop_to = *it_to;
-                length += catalogue.GetCalculateDistance(prev_stop, stop_to);
-                prev_stop = stop_to;
-                double time_on_bus = length / KmDividedOnTime(settings_.bus_velocity_); 
-                graph::Edge<double> edge1 { static_cast<graph::VertexId>(stop_from -> id), static_cast<graph::VertexId>(stop_to -> id), time_on_bus+settings_.bus_wait_time_ };
-                graph.AddEdge(edge1);
-                edges_buses_.push_back({bus.name_bus, static_cast<graph::VertexId>(std::distance(it_from, it_to))});
+// The engine is chosen before anything quadratic is allocated, and an
+// allocation that still fails moves the router one engine down instead of
+// failing the whole process.
+void TransportRouter::CreateGraph(TransportCatalogue& catalogue, ThreadPool& pool) {
+    using namespace std::literals;
+    catalogue_ = &catalogue;
+    std::optional<instrumentation::ScopedTimer> timer(std::in_place, "router.create_graph"sv);
+    const std::deque<Bus>& buses = catalogue.GetAllBuses();
+    size_t ride_count = 0;
+    size_t call_count = 0;
+    bus_indices_.clear();
+    for (size_t bus = 0; bus < buses.size(); ++bus) {
+        const size_t stop_count = buses[bus].stop_names.size();
+        ride_count += stop_count * (stop_count - std::min<size_t>(stop_count, 1)) / 2;
+        call_count += stop_count;
+        bus_indices_[buses[bus].name_bus] = bus;
+    }
+    // Lowest road length per metre of great circle over every span of the bus.
+    std::vector<double> bus_detours(buses.size(), std::numeric_limits<double>::infinity());
+    const geo::UnitSphereArray& stop_points = catalogue.GetStopPoints();
+    pool.ParallelFor(buses.size(), [&](size_t begin, size_t end) {
+        for (size_t bus_index = begin; bus_index < end; ++bus_index) {
+            const Bus& bus = buses[bus_index];
+            for (size_t i = 1; i < bus.stop_names.size(); ++i) {
+                const double straight = stop_points.ComputeDistance(bus.stop_names[i - 1]->id, bus.stop_names[i]->id);
+                if (straight > 0) {
+                    bus_detours[bus_index] = std::min(bus_detours[bus_index], (bus.road_prefix[i] - bus.road_prefix[i - 1]) / straight);
+                }
+            }
+        }
+    });
+    // An edge is at least as long as the great circle times the lowest detour
+    // of its spans.
+    const double detour = buses.empty() ? 0. : *std::min_element(bus_detours.begin(), bus_detours.end());
+    min_detour_ = std::isfinite(detour) ? detour : 0.;
+    id_for_stops.clear();
+    for (const Stop& stop : catalogue.GetAllStops()) {
+        id_for_stops.push_back(stop.name);
+    }
+    instrumentation::AddCounter("router.vertices"sv, static_cast<int64_t>(id_for_stops.size()));
+
+    const EngineEstimate estimate = EstimateEngines(id_for_stops.size(), ride_count, call_count);
+    engine_ = ChooseEngine(estimate);
+    edge_alternative_offsets_.clear();
+    edge_alternatives_.clear();
+    bus_edge_offsets_.clear();
+    bus_edge_ids_.clear();
+    opt_graph_.reset();
+    up_router_.reset();
+    stop_calls_ = {};
+    if (engine_ != RoutingEngine::IMPLICIT || KeepsEdgeGraph(estimate)) {
+        bool built = true;
+        try {
+            BuildEdgeGraph(catalogue, ride_count, pool);
+        } catch (const std::bad_alloc&) {
+            built = false;
+        } catch (const std::length_error&) {
+              built = false;
+          }
+        if (!built) {
+            if (engine_ != RoutingEngine::IMPLICIT) {
+                instrumentation::AddCounter("router.engine_fallbacks"sv);
+                engine_ = RoutingEngine::IMPLICIT;
+            }
+            edges_buses_ = {};
+            bus_edge_offsets_ = {};
+            bus_edge_ids_ = {};
+            edge_alternative_offsets_ = {};
+            edge_alternatives_ = {};
+            opt_graph_.reset();
+        }
+    }
+    timer.reset();
+    if (engine_ == RoutingEngine::ALL_PAIRS) {
+        instrumentation::AddCounter("router.table_bytes"sv, static_cast<int64_t>(estimate.table_bytes));
+        timer.emplace("router.precompute"sv);
+        try {
+            up_router_ = std::make_unique<graph::Router<double, RouteIndex>>(opt_graph_.value());
+        } catch (const std::bad_alloc&) {
+            instrumentation::AddCounter("router.engine_fallbacks"sv);
+            engine_ = RoutingEngine::GRAPH_SEARCH;
+        }
+        timer.reset();
+    } else if (engine_ == RoutingEngine::IMPLICIT) {
+          // Rides are expanded per query from the prefix distances; the edge graph,
+          // if the budget kept it, serves only the multi-route requests.
+          stop_calls_.Build(catalogue);
+      }
+    instrumentation::AddCounter("router.engine."s + std::string{GetEngineName(engine_)});
+    const size_t estimated_bytes = GetEstimatedBytes(estimate, engine_) + (engine_ == RoutingEngine::IMPLICIT && opt_graph_ ? estimate.graph_bytes : 0);
+    instrumentation::AddCounter("router.estimated_bytes"sv, static_cast<int64_t>(estimated_bytes));
+    timetable_.Build(catalogue);
+}
+
+// Every bus gets a slice of the edge array sized from its stop count, so the
+// buses are expanded in parallel straight into their final positions and the
+// edge ids come out the same as with a sequential build. Ride lengths are
+// differences of the route prefix distances.
+void TransportRouter::BuildEdgeGraph(const TransportCatalogue& catalogue, size_t ride_count, ThreadPool& pool) {
+    using namespace std::literals;
+    const std::deque<Bus>& buses = catalogue.GetAllBuses();
+    std::vector<size_t> bus_offsets(buses.size() + 1, 0);
+    for (size_t bus = 0; bus < buses.size(); ++bus) {
+        const size_t stop_count = buses[bus].stop_names.size();
+        bus_offsets[bus + 1] = bus_offsets[bus] + stop_count * (stop_count - std::min<size_t>(stop_count, 1)) / 2;
+    }
+    std::vector<graph::Edge<double, RouteIndex>> edges(ride_count);
+    edges_buses_.assign(ride_count, {});
+    pool.ParallelFor(buses.size(), [&](size_t begin, size_t end) {
+        for (size_t bus_index = begin; bus_index < end; ++bus_index) {
+            const Bus& bus = buses[bus_index];
+            const size_t stop_count = bus.stop_names.size();
+            size_t edge_id = bus_offsets[bus_index];
+            for (size_t from = 0; from < stop_count; ++from) {
+                for (size_t to = from + 1; to < stop_count; ++to) {
+                    edges_buses_[edge_id] = {bus.name_bus, to - from, bus.road_prefix[to] - bus.road_prefix[from]};
+                    edges[edge_id] = {static_cast<RouteIndex>(bus.stop_names[from]->id), static_cast<RouteIndex>(bus.stop_names[to]->id), GetEdgeWeight(edge_id, settings_)};
+                    ++edge_id;
+                }
+            }
+        }
+    });
+    CollapseParallelEdges(edges, pool);
+    instrumentation::AddCounter("router.collapsed_edges"sv, static_cast<int64_t>(edge_alternatives_.size()));
+    // The edges each bus rides after collapsing, so that suspending a bus
+    // touches only those.
+    bus_edge_offsets_.assign(buses.size() + 1, 0);
+    std::vector<size_t> edge_buses(edges_buses_.size());
+    for (graph::EdgeId edge_id = 0; edge_id < edges_buses_.size(); ++edge_id) {
+        edge_buses[edge_id] = bus_indices_.at(edges_buses_[edge_id].bus_name);
+        ++bus_edge_offsets_[edge_buses[edge_id] + 1];
+    }
+    std::partial_sum(bus_edge_offsets_.begin(), bus_edge_offsets_.end(), bus_edge_offsets_.begin());
+    bus_edge_ids_.resize(edges_buses_.size());
+    std::vector<size_t> next_bus_edge(bus_edge_offsets_.begin(), bus_edge_offsets_.end() - 1);
+    for (graph::EdgeId edge_id = 0; edge_id < edges_buses_.size(); ++edge_id) {
+        bus_edge_ids_[next_bus_edge[edge_buses[edge_id]]++] = edge_id;
+    }
+    opt_graph_.emplace(catalogue.GetAllStops().size(), std::move(edges));
+    instrumentation::AddCounter("router.edges"sv, static_cast<int64_t>(opt_graph_->GetEdgeCount()));
+}
+
+// Upper bounds: parallel edges are counted before they are collapsed, since
+// the build holds all of them at once.
+TransportRouter::EngineEstimate TransportRouter::EstimateEngines(size_t stop_count, size_t ride_count, size_t call_count) const {
+    EngineEstimate estimate;
+    estimate.graph_bytes = ride_count * (sizeof(graph::Edge<double, RouteIndex>) + sizeof(RouteIndex) + sizeof(EdgeAditionInfo))
+        + (stop_count + 1) * sizeof(RouteIndex);
+    estimate.table_bytes = graph::Router<double, RouteIndex>::GetTableBytes(stop_count);
+    estimate.implicit_bytes = call_count * sizeof(StopCalls::Call) + (stop_count + 1) * sizeof(size_t);
+    return estimate;
+}
+
+// The all-pairs table answers fastest, so it is taken whenever it fits; a
+// per-query search over the graph comes next, and the implicit search needs
+// only memory linear in the routes.
+RoutingEngine TransportRouter::ChooseEngine(const EngineEstimate& estimate) const {
+    if (settings_.implicit_edges_) {
+        return RoutingEngine::IMPLICIT;
+    }
+    if (settings_.memory_budget_mb_ <= 0) {
+        return RoutingEngine::ALL_PAIRS;
+    }
+    const double budget = settings_.memory_budget_mb_ * 1024 * 1024;
+    if (GetEstimatedBytes(estimate, RoutingEngine::ALL_PAIRS) <= budget) {
+        return RoutingEngine::ALL_PAIRS;
+    }
+    if (GetEstimatedBytes(estimate, RoutingEngine::GRAPH_SEARCH) <= budget) {
+        return RoutingEngine::GRAPH_SEARCH;
+    }
+    return RoutingEngine::IMPLICIT;
+}
+
+// Pareto and alternative routes walk materialized edges, so the implicit
+// engine keeps them as well when the budget covers both.
+bool TransportRouter::KeepsEdgeGraph(const EngineEstimate& estimate) const {
+    if (settings_.memory_budget_mb_ <= 0) {
+        return false;
+    }
+    const double budget = settings_.memory_budget_mb_ * 1024 * 1024;
+    return GetEstimatedBytes(estimate, RoutingEngine::IMPLICIT) + estimate.graph_bytes <= budget;
+}
+
+size_t TransportRouter::GetEstimatedBytes(const EngineEstimate& estimate, RoutingEngine engine) {
+    switch (engine) {
+        case RoutingEngine::ALL_PAIRS: return estimate.graph_bytes + estimate.table_bytes;
+        case RoutingEngine::GRAPH_SEARCH: return estimate.graph_bytes;
+        case RoutingEngine::IMPLICIT: return estimate.implicit_bytes;
+    }
+    return 0;
+}
+
+std::string_view GetEngineName(RoutingEngine engine) {
+    using namespace std::literals;
+    switch (engine) {
+        case RoutingEngine::ALL_PAIRS: return "all_pairs"sv;
+        case RoutingEngine::GRAPH_SEARCH: return "graph_search"sv;
+        case RoutingEngine::IMPLICIT: return "implicit"sv;
+    }
+    return {};
+}
+
+RoutingEngine TransportRouter::GetEngine() const {
+    return engine_;
+}
+
+// Parallel edges differ only in the bus and the road distance, and a longer
+// ride is slower under any wait and velocity, so the shortest one dominates,
+// the earliest one on ties as in the router. The others stay as the
+// alternatives of the surviving edge for queries that suspend its bus.
+void TransportRouter::CollapseParallelEdges(std::vector<graph::Edge<double, RouteIndex>>& edges, ThreadPool& pool) {
+    const size_t vertex_count = id_for_stops.size();
+    std::vector<size_t> row_offsets(vertex_count + 1, 0);
+    for (const auto& edge : edges) {
+        ++row_offsets[edge.from + 1];
+    }
+    for (size_t vertex = 0; vertex < vertex_count; ++vertex) {
+        row_offsets[vertex + 1] += row_offsets[vertex];
+    }
+    std::vector<graph::EdgeId> order(edges.size());
+    {
+        std::vector<size_t> next(row_offsets.begin(), row_offsets.end() - 1);
+        for (graph::EdgeId edge_id = 0; edge_id < edges.size(); ++edge_id) {
+            order[next[edges[edge_id].from]++] = edge_id;
+        }
+    }
+    // Each row is sorted by target, then distance, so a group's first edge dominates it.
+    std::vector<graph::EdgeId> dominant(edges.size());
+    pool.ParallelFor(vertex_count, [&](size_t begin, size_t end) {
+        for (size_t vertex = begin; vertex < end; ++vertex) {
+            const auto first = order.begin() + row_offsets[vertex];
+            const auto last = order.begin() + row_offsets[vertex + 1];
+            std::sort(first, last, [&](graph::EdgeId lhs, graph::EdgeId rhs) {
+                return std::make_tuple(edges[lhs].to, edges_buses_[lhs].distance, lhs) < std::make_tuple(edges[rhs].to, edges_buses_[rhs].distance, rhs);
+            });
+            for (auto group = first; group != last;) {
+                auto group_end = group;
+                while (group_end != last && edges[*group_end].to == edges[*group].to) {
+                    dominant[*group_end++] = *group;
+                }
+                group = group_end;
             }
         }
+    });
+    // Survivors keep their relative order, so new ids never exceed old ones.
+    std::vector<graph::EdgeId> new_ids(edges.size());
+    size_t kept = 0;
+    for (graph::EdgeId edge_id = 0; edge_id < edges.size(); ++edge_id) {
+        if (dominant[edge_id] == edge_id) {
+            new_ids[edge_id] = kept++;
+        }
+    }
+    edge_alternative_offsets_.assign(kept + 1, 0);
+    for (graph::EdgeId edge_id = 0; edge_id < edges.size(); ++edge_id) {
+        if (dominant[edge_id] != edge_id) {
+            ++edge_alternative_offsets_[new_ids[dominant[edge_id]] + 1];
+        }
+    }
+    for (size_t edge_id = 0; edge_id < kept; ++edge_id) {
+        edge_alternative_offsets_[edge_id + 1] += edge_alternative_offsets_[edge_id];
     }
-    opt_graph_ = std::move(graph);
-    up_router_ = std::make_unique<graph::Router<double>>(opt_graph_.value());
+    edge_alternatives_.resize(edge_alternative_offsets_.back());
+    std::vector<size_t> next(edge_alternative_offsets_.begin(), edge_alternative_offsets_.end() - 1);
+    for (const graph::EdgeId edge_id : order) {
+        if (dominant[edge_id] != edge_id) {
+            edge_alternatives_[next[new_ids[dominant[edge_id]]]++] = edges_buses_[edge_id];
+        }
+    }
+    for (graph::EdgeId edge_id = 0; edge_id < edges.size(); ++edge_id) {
+        if (dominant[edge_id] == edge_id) {
+            edges[new_ids[edge_id]] = edges[edge_id];
+            edges_buses_[new_ids[edge_id]] = edges_buses_[edge_id];
+        }
+    }
+    edges.resize(kept);
+    edges_buses_.resize(kept);
+    edges_buses_.shrink_to_fit();
 }
 
 std::optional<RouteStatistic> TransportRouter::GetRouteStat(size_t id_stop_from, size_t id_stop_to) const {
+    if (IsUnreachable(id_stop_from, id_stop_to)) {
+        return std::nullopt;
+    }
+    if (!up_router_) {
+        return GetRouteStat(RoutePoint{id_stop_from}, RoutePoint{id_stop_to}, {}, settings_);
+    }
     const OptRouteInfo opt_route_info = up_router_->BuildRoute(id_stop_from, id_stop_to);
     if(! opt_route_info.has_value()) {
         return std::nullopt;
     }
-    const graph::Router<double>::RouteInfo& route_info = opt_route_info.value();
+    const graph::Router<double, RouteIndex>::RouteInfo& route_info = opt_route_info.value();
     double total_time = route_info.weight;
     std::vector<RouteStatistic::VariantItem> items;
-    for(const auto& edge_id : route_info.edges) {
+    AddRideItems(route_info.edges, items);
+    return RouteStatistic{total_time, items};
+}
+
+std::vector<std::optional<RouteStatistic>> TransportRouter::GetRouteStats(size_t id_stop_from, const std::vector<size_t>& id_stops_to) const {
+    using namespace std::literals;
+    std::vector<std::optional<RouteStatistic>> result(id_stops_to.size());
+    // The table and the implicit search answer each pair on their own.
+    if (up_router_ || engine_ == RoutingEngine::IMPLICIT || id_stops_to.size() < 2) {
+        for (size_t i = 0; i < id_stops_to.size(); ++i) {
+            result[i] = GetRouteStat(id_stop_from, id_stops_to[i]);
+        }
+        return result;
+    }
+    std::vector<size_t> reachable;
+    std::vector<graph::VertexId> targets;
+    for (size_t i = 0; i < id_stops_to.size(); ++i) {
+        if (!IsUnreachable(id_stop_from, id_stops_to[i])) {
+            reachable.push_back(i);
+            targets.push_back(static_cast<graph::VertexId>(id_stops_to[i]));
+        }
+    }
+    if (targets.empty()) {
+        return result;
+    }
+    graph::ShortestPathSearch<double, RouteIndex> search(opt_graph_.value());
+    const auto routes = search.BuildRoutes(static_cast<graph::VertexId>(id_stop_from), targets);
+    instrumentation::AddCounter("search.queries"sv);
+    instrumentation::AddCounter("search.shared_targets"sv, static_cast<int64_t>(targets.size()));
+    instrumentation::AddCounter("search.settled_vertices"sv, static_cast<int64_t>(search.GetSettledCount()));
+    for (size_t i = 0; i < reachable.size(); ++i) {
+        if (const auto& route_info = routes[i]) {
+            RouteStatistic stat{route_info->weight, {}};
+            AddRideItems(route_info->edges, stat.items);
+            result[reachable[i]] = std::move(stat);
+        }
+    }
+    return result;
+}
+
+std::optional<RouteStatistic> TransportRouter::GetRouteStat(const RoutePoint& from, const RoutePoint& to, const Disruption& disruption) const {
+    return GetRouteStat(from, to, disruption, settings_);
+}
+
+std::optional<RouteStatistic> TransportRouter::GetRouteStat(const RoutePoint& from, const RoutePoint& to, const Disruption& disruption, const RoutingSettings& settings) const {
+    using namespace std::literals;
+    const bool base_weights = HasBaseWeights(settings);
+    if (from.stop_id && to.stop_id && disruption.IsEmpty() && base_weights && up_router_) {
+        return GetRouteStat(*from.stop_id, *to.stop_id);
+    }
+    AccessLegs origins = GetAccessLegs(from, settings);
+    AccessLegs destinations = GetAccessLegs(to, settings);
+    const auto is_closed = [&disruption](const auto& leg) {
+        return std::find(disruption.closed_stops.begin(), disruption.closed_stops.end(), leg.vertex) != disruption.closed_stops.end();
+    };
+    origins.erase(std::remove_if(origins.begin(), origins.end(), is_closed), origins.end());
+    destinations.erase(std::remove_if(destinations.begin(), destinations.end(), is_closed), destinations.end());
+    // Origin stops that reach none of the destination stops only widen the search.
+    origins.erase(std::remove_if(origins.begin(), origins.end(), [this, &destinations](const auto& origin) {
+        return std::all_of(destinations.begin(), destinations.end(), [this, &origin](const auto& destination) {
+            return IsUnreachable(origin.vertex, destination.vertex);
+        });
+    }), origins.end());
+    if (!base_weights) {
+        instrumentation::AddCounter("search.reweighted_queries"sv);
+    }
+    if (!disruption.IsEmpty()) {
+        instrumentation::AddCounter("search.disrupted_queries"sv);
+    }
+    // A single search from every origin stop at once, finishing at the destination stop
+    // with the smallest arrival time plus the walk from it.
+    std::optional<FoundRoute> route_info;
+    if (!origins.empty()) {
+        route_info = engine_ != RoutingEngine::IMPLICIT ? SearchGraph(origins, destinations, disruption, settings) : SearchImplicit(origins, destinations, disruption, settings);
+    }
+    std::optional<double> direct_distance;
+    if (!from.stop_id && !to.stop_id) {
+        direct_distance = geo::ComputeDistance(from.coord, to.coord);
+    }
+    if (direct_distance && (!route_info || GetWalkingTime(*direct_distance, settings) <= route_info->weight)) {
+        const double time = GetWalkingTime(*direct_distance, settings);
+        return RouteStatistic{time, {RouteStatistic::ItemsWalk{"Walk", time, *direct_distance}}};
+    }
+    if (!route_info) {
+        return std::nullopt;
+    }
+    auto add_walk = [](const AccessLegs& legs, graph::VertexId vertex, std::vector<RouteStatistic::VariantItem>& items) {
+        for (const auto& leg : legs) {
+            if (leg.vertex == vertex) {
+                items.push_back(RouteStatistic::ItemsWalk{"Walk", leg.weight, leg.distance});
+                return;
+            }
+        }
+    };
+    std::vector<RouteStatistic::VariantItem> items;
+    if (!from.stop_id) {
+        add_walk(origins, route_info->source, items);
+    }
+    items.insert(items.end(), std::make_move_iterator(route_info->items.begin()), std::make_move_iterator(route_info->items.end()));
+    if (!to.stop_id) {
+        add_walk(destinations, route_info->target, items);
+    }
+    return RouteStatistic{route_info->weight, items};
+}
+
+std::optional<RouteStatistic> TransportRouter::GetRouteStat(size_t id_stop_from, size_t id_stop_to, double departure_time) const {
+    if (IsUnreachable(id_stop_from, id_stop_to)) {
+        return std::nullopt;
+    }
+    const auto journey = timetable_.FindEarliestArrival(id_stop_from, id_stop_to, departure_time, settings_.max_transfers_ + 1);
+    if (!journey) {
+        return std::nullopt;
+    }
+    const std::deque<Bus>& buses = catalogue_->GetAllBuses();
+    std::vector<RouteStatistic::VariantItem> items;
+    double time = departure_time;
+    for (const Timetable::Leg& leg : journey->legs) {
+        const Bus& bus = buses[leg.bus];
+        items.push_back(RouteStatistic::ItemsWait{"Wait", leg.departure - time, bus.stop_names[leg.board]->name});
+        items.push_back(RouteStatistic::ItemsBus{"Bus", leg.arrival - leg.departure, leg.alight - leg.board, bus.name_bus});
+        time = leg.arrival;
+    }
+    return RouteStatistic{journey->arrival - departure_time, items};
+}
+
+std::vector<RouteStatistic> TransportRouter::GetParetoRouteStats(size_t id_stop_from, size_t id_stop_to) const {
+    using namespace std::literals;
+    if (IsUnreachable(id_stop_from, id_stop_to)) {
+        return {};
+    }
+    // Both searches walk materialized edges; without them the fastest route is the only answer.
+    if (!opt_graph_) {
+        return GetFastestRouteStats(id_stop_from, id_stop_to);
+    }
+    graph::ParetoSearch<double, RouteIndex> search(opt_graph_.value());
+    const auto routes = search.BuildRoutes(id_stop_from, id_stop_to, static_cast<size_t>(std::max(settings_.max_transfers_, 0)) + 1, static_cast<size_t>(std::max(settings_.pareto_label_limit_, 1)));
+    instrumentation::AddCounter("pareto.queries"sv);
+    instrumentation::AddCounter("pareto.labels"sv, static_cast<int64_t>(search.GetLabelCount()));
+    instrumentation::AddCounter("pareto.settled_labels"sv, static_cast<int64_t>(search.GetSettledCount()));
+    instrumentation::AddCounter("pareto.routes"sv, static_cast<int64_t>(routes.size()));
+    if (search.IsTruncated()) {
+        instrumentation::AddCounter("pareto.truncated"sv);
+    }
+    std::vector<RouteStatistic> result;
+    result.reserve(routes.size());
+    for (const auto& route : routes) {
+        RouteStatistic stat{route.weight, {}};
+        AddRideItems(route.edges, stat.items);
+        result.push_back(std::move(stat));
+    }
+    // A capped search may stop before reaching the target; the fastest route is still an answer.
+    if (result.empty() && search.IsTruncated()) {
+        if (auto fastest = GetRouteStat(id_stop_from, id_stop_to)) {
+            result.push_back(std::move(*fastest));
+        }
+    }
+    return result;
+}
+
+std::vector<RouteStatistic> TransportRouter::GetAlternativeRouteStats(size_t id_stop_from, size_t id_stop_to, size_t count) const {
+    using namespace std::literals;
+    if (IsUnreachable(id_stop_from, id_stop_to)) {
+        return {};
+    }
+    if (!opt_graph_) {
+        return GetFastestRouteStats(id_stop_from, id_stop_to);
+    }
+    graph::KShortestPaths<double, RouteIndex> search(opt_graph_.value());
+    const auto no_reboarding = [this](const std::vector<graph::EdgeId>& edges) {
+        for (size_t i = 1; i < edges.size(); ++i) {
+            if (edges_buses_[edges[i - 1]].bus_name == edges_buses_[edges[i]].bus_name) {
+                return false;
+            }
+        }
+        return true;
+    };
+    search.SetHeuristic(MakeHeuristic({{static_cast<graph::VertexId>(id_stop_to), 0}}, settings_));
+    const auto routes = search.BuildRoutes(id_stop_from, id_stop_to, count, static_cast<size_t>(std::max(settings_.alternative_work_limit_, 1)), no_reboarding);
+    instrumentation::AddCounter("alternatives.queries"sv);
+    instrumentation::AddCounter("alternatives.spur_searches"sv, static_cast<int64_t>(search.GetSpurSearchCount()));
+    instrumentation::AddCounter("alternatives.settled_vertices"sv, static_cast<int64_t>(search.GetSettledCount()));
+    instrumentation::AddCounter("alternatives.routes"sv, static_cast<int64_t>(routes.size()));
+    if (search.IsTruncated()) {
+        instrumentation::AddCounter("alternatives.truncated"sv);
+    }
+    std::vector<RouteStatistic> result;
+    result.reserve(routes.size());
+    for (const auto& route : routes) {
+        RouteStatistic stat{route.weight, {}};
+        AddRideItems(route.edges, stat.items);
+        result.push_back(std::move(stat));
+    }
+    return result;
+}
+
+std::vector<RouteStatistic> TransportRouter::GetFastestRouteStats(size_t id_stop_from, size_t id_stop_to) const {
+    using namespace std::literals;
+    instrumentation::AddCounter("router.fastest_only_answers"sv);
+    std::vector<RouteStatistic> result;
+    if (auto fastest = GetRouteStat(id_stop_from, id_stop_to)) {
+        result.push_back(std::move(*fastest));
+    }
+    return result;
+}
+
+bool TransportRouter::HasTimetable() const {
+    return !timetable_.IsEmpty();
+}
+
+std::optional<TransportRouter::FoundRoute> TransportRouter::SearchGraph(const AccessLegs& origins, const AccessLegs& destinations,
+                                                                       const Disruption& disruption, const RoutingSettings& settings) const {
+    using namespace std::literals;
+    // The masks of a thread are reused by its later searches instead of being
+    // sized over all edges again.
+    thread_local graph::ShortestPathSearch<double, RouteIndex>::BlockMasks masks;
+    graph::ShortestPathSearch<double, RouteIndex> search(opt_graph_.value(), &masks);
+    search.SetHeuristic(MakeHeuristic(destinations, settings));
+    for (const size_t stop : disruption.closed_stops) {
+        search.BlockVertex(stop);
+    }
+    // An edge of a suspended bus falls back to its shortest alternative on another bus.
+    RideSubstitutes substitutes;
+    const auto is_suspended = [&disruption](const EdgeAditionInfo& ride) {
+        return std::find(disruption.suspended_buses.begin(), disruption.suspended_buses.end(), ride.bus_name) != disruption.suspended_buses.end();
+    };
+    for (const std::string_view bus : disruption.suspended_buses) {
+        const auto bus_i = bus_indices_.find(bus);
+        if (bus_i == bus_indices_.end()) {
+            continue;
+        }
+        for (size_t i = bus_edge_offsets_[bus_i->second]; i < bus_edge_offsets_[bus_i->second + 1]; ++i) {
+            const graph::EdgeId edge_id = bus_edge_ids_[i];
+            const auto first = edge_alternatives_.begin() + edge_alternative_offsets_[edge_id];
+            const auto last = edge_alternatives_.begin() + edge_alternative_offsets_[edge_id + 1];
+            if (const auto substitute = std::find_if_not(first, last, is_suspended); substitute != last) {
+                substitutes.emplace(edge_id, &*substitute);
+            } else {
+                  search.BlockEdge(edge_id);
+              }
+        }
+    }
+    if (!HasBaseWeights(settings) || !substitutes.empty()) {
+        search.SetEdgeWeight([this, &settings, &substitutes](graph::EdgeId edge_id) {
+            const auto substitute_i = substitutes.find(edge_id);
+            return GetRideWeight(substitute_i != substitutes.end() ? *substitute_i->second : edges_buses_[edge_id], settings);
+        });
+    }
+    const auto route_info = search.BuildRoute(GetTerminals(origins), GetTerminals(destinations));
+    instrumentation::AddCounter("search.queries"sv);
+    instrumentation::AddCounter("search.settled_vertices"sv, static_cast<int64_t>(search.GetSettledCount()));
+    if (!route_info) {
+        return std::nullopt;
+    }
+    FoundRoute found{route_info->source, route_info->target, route_info->weight, {}};
+    AddRideItems(route_info->edges, found.items, settings, substitutes);
+    return found;
+}
+
+std::optional<TransportRouter::FoundRoute> TransportRouter::SearchImplicit(const AccessLegs& origins, const AccessLegs& destinations,
+                                                                          const Disruption& disruption, const RoutingSettings& settings) const {
+    using namespace std::literals;
+    ImplicitRouteSearch search(catalogue_->GetAllBuses(), stop_calls_);
+    search.SetHeuristic(MakeHeuristic(destinations, settings));
+    for (const size_t stop : disruption.closed_stops) {
+        search.CloseStop(stop);
+    }
+    for (const std::string_view bus : disruption.suspended_buses) {
+        if (const auto bus_i = bus_indices_.find(bus); bus_i != bus_indices_.end()) {
+            search.SuspendBus(bus_i->second);
+        }
+    }
+    const auto route_info = search.BuildRoute(GetTerminals(origins), GetTerminals(destinations), settings.bus_wait_time_, settings.bus_velocity_);
+    instrumentation::AddCounter("search.queries"sv);
+    instrumentation::AddCounter("search.settled_vertices"sv, static_cast<int64_t>(search.GetSettledCount()));
+    if (!route_info) {
+        return std::nullopt;
+    }
+    FoundRoute found{route_info->source, route_info->target, route_info->weight, {}};
+    const std::deque<Bus>& buses = catalogue_->GetAllBuses();
+    for (const ImplicitRouteSearch::Ride& ride : route_info->rides) {
+        const Bus& bus = buses[ride.bus];
+        const double length = bus.road_prefix[ride.to_index] - bus.road_prefix[ride.from_index];
+        found.items.push_back(RouteStatistic::ItemsWait{"Wait", settings.bus_wait_time_, bus.stop_names[ride.from_index]->name});
+        found.items.push_back(RouteStatistic::ItemsBus{"Bus", GetRideTime(length, settings),
+                                                       ride.to_index - ride.from_index, bus.name_bus});
+    }
+    return found;
+}
+
+// A catalogue filled without BuildStopComponents has no labels and proves nothing.
+bool TransportRouter::IsUnreachable(size_t id_stop_from, size_t id_stop_to) const {
+    using namespace std::literals;
+    const graph::Components& components = catalogue_->GetStopComponents();
+    if (components.Size() != id_for_stops.size() || components.MayReach(id_stop_from, id_stop_to)) {
+        return false;
+    }
+    instrumentation::AddCounter("router.unreachable_pairs"sv);
+    return true;
+}
+
+// The precomputed table and the stored edge weights hold only for the base
+// waits and velocities.
+bool TransportRouter::HasBaseWeights(const RoutingSettings& settings) const {
+    return settings.bus_wait_time_ == settings_.bus_wait_time_ && settings.bus_velocity_ == settings_.bus_velocity_;
+}
+
+double TransportRouter::GetEdgeWeight(graph::EdgeId edge_id, const RoutingSettings& settings) const {
+    return GetRideWeight(edges_buses_[edge_id], settings);
+}
+
+double TransportRouter::GetRideWeight(const EdgeAditionInfo& ride, const RoutingSettings& settings) const {
+    return GetRideTime(ride.distance, settings) + settings.bus_wait_time_;
+}
+
+double TransportRouter::GetRideTime(double distance, const RoutingSettings& settings) const {
+    return distance / KmDividedOnTime(settings.bus_velocity_);
+}
+
+TransportRouter::AccessLegs TransportRouter::GetAccessLegs(const RoutePoint& point, const RoutingSettings& settings) const {
+    if (point.stop_id) {
+        return {{*point.stop_id, 0, 0}};
+    }
+    AccessLegs legs;
+    const auto stop_count = static_cast<size_t>(std::max(settings.walking_stop_count_, 0));
+    for (const auto& neighbour : catalogue_->GetStopIndex().FindNearest(point.coord, stop_count)) {
+        if (neighbour.distance > settings.max_walking_distance_) {
+            break;
+        }
+        legs.push_back({static_cast<graph::VertexId>(neighbour.stop_id), GetWalkingTime(neighbour.distance, settings), neighbour.distance});
+    }
+    return legs;
+}
+
+TransportRouter::Terminals TransportRouter::GetTerminals(const AccessLegs& legs) {
+    Terminals terminals;
+    terminals.reserve(legs.size());
+    for (const AccessLeg& leg : legs) {
+        terminals.push_back({leg.vertex, leg.weight});
+    }
+    return terminals;
+}
+
+// Rides cover the great circle no faster than min_detour_ road metres per
+// metre at the bus velocity, so the time to the closest destination stop plus
+// the walk from it bounds the rest of a route. The slack keeps the bound
+// consistent under rounding.
+graph::ShortestPathSearch<double, RouteIndex>::Heuristic TransportRouter::MakeHeuristic(const AccessLegs& destinations, const RoutingSettings& settings) const {
+    if (!settings.goal_directed_search_ || min_detour_ <= 0 || settings.bus_velocity_ <= 0 || destinations.empty()) {
+        return {};
+    }
+    const geo::UnitSphereArray& stop_points = catalogue_->GetStopPoints();
+    const double time_per_meter = min_detour_ / KmDividedOnTime(settings.bus_velocity_) * (1 - 1e-9);
+    return [&stop_points, destinations, time_per_meter](graph::VertexId vertex) {
+        double bound = std::numeric_limits<double>::infinity();
+        for (const auto& leg : destinations) {
+            bound = std::min(bound, stop_points.ComputeDistance(vertex, leg.vertex) * time_per_meter + leg.weight);
+        }
+        return bound;
+    };
+}
+
+double TransportRouter::GetWalkingTime(double distance, const RoutingSettings& settings) const {
+    return distance / KmDividedOnTime(settings.walking_velocity_);
+}
+
+void TransportRouter::AddRideItems(const std::vector<graph::EdgeId>& edges, std::vector<RouteStatistic::VariantItem>& items) const {
+    AddRideItems(edges, items, settings_);
+}
+
+void TransportRouter::AddRideItems(const std::vector<graph::EdgeId>& edges, std::vector<RouteStatistic::VariantItem>& items, const RoutingSettings& settings,
+                                   const RideSubstitutes& substitutes) const {
+    for(const auto& edge_id : edges) {
         const auto& edge = opt_graph_.value().GetEdge(edge_id);
-        const auto [bus_num, span_count] = edges_buses_[edge_id];
-        items.push_back(RouteStatistic::ItemsWait{"Wait", settings_.bus_wait_time_, std::string(id_for_stops[edge.from])});
-        items.push_back(RouteStatistic::ItemsBus{"Bus", edge.weight - settings_.bus_wait_time_, span_count, std::string(bus_num)});
+        const auto substitute_i = substitutes.find(edge_id);
+        const EdgeAditionInfo& ride = substitute_i != substitutes.end() ? *substitute_i->second : edges_buses_[edge_id];
+        items.push_back(RouteStatistic::ItemsWait{"Wait", settings.bus_wait_time_, std::string(id_for_stops[edge.from])});
+        items.push_back(RouteStatistic::ItemsBus{"Bus", GetRideTime(ride.distance, settings), ride.count_spans, std::string(ride.bus_name)});
     }
-    return RouteStatistic{total_time, items};
 }
 
 bool TransportRouter::IsExist() const {
-    return !opt_graph_.has_value();
+    return catalogue_ == nullptr;
+}
+
+void TransportRouter::StartBuild(TransportCatalogue& db, ThreadPool& pool) {
+    std::lock_guard guard(build_mutex_);
+    if (build_.valid() || !IsExist()) {
+        return;
+    }
+    build_ = std::async(std::launch::async, [this, &db, &pool]() {
+        CreateGraph(db, pool);
+    }).share();
+}
+
+// Every caller waits on its own copy of the future, as shared_future requires
+// for concurrent access.
+void TransportRouter::AwaitBuild() const {
+    using namespace std::literals;
+    std::shared_future<void> build;
+    {
+        std::lock_guard guard(build_mutex_);
+        build = build_;
+    }
+    if (!build.valid()) {
+        return;
+    }
+    if (build.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        instrumentation::ScopedTimer timer("router.await_build"sv);
+        build.wait();
+    }
+    build.get();
 }
     
 } //namespace transport_catalogue 
@@ -2,36 +2,189 @@
 
 #include "graph.h"
 #include "router.h"
+#include "graph_search.h"
+#include "pareto_search.h"
+#include "k_shortest_paths.h"
+#include "implicit_search.h"
 #include "domain.h"
 #include "transport_catalogue.h"
+#include "timetable.h"
+#include "thread_pool.h"
+
+#include <future>
+#include <mutex>
 
 namespace transport_catalogue {
     
 struct RoutingSettings {
     double bus_wait_time_ = 0; 
     double bus_velocity_ = 0;
+    double walking_velocity_ = 5;
+    double max_walking_distance_ = 1000;
+    int walking_stop_count_ = 5;
+    // Timetable and Pareto journeys use at most max_transfers_ + 1 trips.
+    int max_transfers_ = 4;
+    // Labels one Pareto query may create before it stops extending them.
+    int pareto_label_limit_ = 100000;
+    // Vertices all spur searches of one alternatives query may settle.
+    int alternative_work_limit_ = 200000;
+    // Per-query searches run as A* with a geographic lower bound.
+    bool goal_directed_search_ = true;
+    // No edges and no all-pairs table: every route is searched per query
+    // with the rides expanded from the route prefix distances.
+    bool implicit_edges_ = false;
+    // Memory the router may take, in megabytes; 0 leaves it unlimited.
+    double memory_budget_mb_ = 0;
+};
+
+// How TransportRouter answers Route requests, fastest first:
+// the all-pairs table, a per-query search over the edge graph, or a per-query
+// search with implicit edges.
+enum class RoutingEngine {
+    ALL_PAIRS,
+    GRAPH_SEARCH,
+    IMPLICIT
+};
+
+std::string_view GetEngineName(RoutingEngine engine);
+
+// Either end of a route: a stop, or an arbitrary point reached on foot.
+struct RoutePoint {
+    std::optional<size_t> stop_id;
+    geo::Coordinates coord{0, 0};
+};
+
+// Stops and buses left out of one query. The graph stays shared and untouched;
+// the per-query search masks them.
+struct Disruption {
+    std::vector<size_t> closed_stops;
+    std::vector<std::string_view> suspended_buses;
+
+    bool IsEmpty() const {
+        return closed_stops.empty() && suspended_buses.empty();
+    }
 };
 
 class TransportRouter {
 public:
-    using OptRouteInfo = std::optional<graph::Router<double>::RouteInfo>;
+    using OptRouteInfo = std::optional<graph::Router<double, RouteIndex>::RouteInfo>;
     
     RoutingSettings settings_;
     TransportRouter() = default;
-    void CreateGraph(TransportCatalogue& db);
+    // The parallel stages run on pool, which must not be running this call.
+    void CreateGraph(TransportCatalogue& db, ThreadPool& pool);
+    // Runs CreateGraph on a background thread unless the graph is built or
+    // being built already. The catalogue must stay unchanged and the pool
+    // alive until it ends.
+    void StartBuild(TransportCatalogue& db, ThreadPool& pool);
+    // Waits for a started build and rethrows what it threw; returns at once
+    // if none was started.
+    void AwaitBuild() const;
     std::optional<RouteStatistic> GetRouteStat(size_t id_stop_from, size_t id_stop_to) const;
+    // Same for many targets of one origin; a per-query graph search answers
+    // them all out of one search.
+    std::vector<std::optional<RouteStatistic>> GetRouteStats(size_t id_stop_from, const std::vector<size_t>& id_stops_to) const;
+    // A closed stop can neither be boarded, left nor be an end of the route;
+    // buses still pass through it.
+    std::optional<RouteStatistic> GetRouteStat(const RoutePoint& from, const RoutePoint& to, const Disruption& disruption = {}) const;
+    // Same with the waits and velocities of settings in place of settings_.
+    // Edges keep their distances, so the weights are evaluated per query.
+    std::optional<RouteStatistic> GetRouteStat(const RoutePoint& from, const RoutePoint& to, const Disruption& disruption, const RoutingSettings& settings) const;
+    // Time-dependent variant over the bus trips: waits are the real gaps
+    // until the boarded trip leaves, departure_time in minutes from midnight.
+    std::optional<RouteStatistic> GetRouteStat(size_t id_stop_from, size_t id_stop_to, double departure_time) const;
+    // Routes that are best in either total time or number of transfers,
+    // fastest first; each has fewer transfers than the one before it. An
+    // implicit engine without the edge graph answers with the fastest route.
+    std::vector<RouteStatistic> GetParetoRouteStats(size_t id_stop_from, size_t id_stop_to) const;
+    // Up to count fastest routes, the fastest first. Routes that leave a bus
+    // only to board the same bus again are skipped. Falls back like the Pareto set.
+    std::vector<RouteStatistic> GetAlternativeRouteStats(size_t id_stop_from, size_t id_stop_to, size_t count) const;
+    bool HasTimetable() const;
     bool IsExist() const;
+    RoutingEngine GetEngine() const;
 
 private:
     struct EdgeAditionInfo {
-        std::string bus_name; 
+        std::string_view bus_name;
         size_t count_spans = 0;
+        double distance = 0;
     };
     
+    // A walk between a point and a stop, with the measured distance kept for the Walk item.
+    struct AccessLeg {
+        graph::VertexId vertex;
+        double weight;
+        double distance;
+    };
+
+    using AccessLegs = std::vector<AccessLeg>;
+    using Terminals = std::vector<graph::ShortestPathSearch<double, RouteIndex>::Terminal>;
+    // Rides a query takes in place of edges whose own bus it suspends.
+    using RideSubstitutes = std::unordered_map<graph::EdgeId, const EdgeAditionInfo*>;
+
+    // A per-query search result with its rides already turned into items.
+    struct FoundRoute {
+        graph::VertexId source;
+        graph::VertexId target;
+        double weight;
+        std::vector<RouteStatistic::VariantItem> items;
+    };
+
+    // Bytes each engine is expected to take for the current base.
+    struct EngineEstimate {
+        size_t graph_bytes = 0;
+        size_t table_bytes = 0;
+        size_t implicit_bytes = 0;
+    };
+
+    void BuildEdgeGraph(const TransportCatalogue& catalogue, size_t ride_count, ThreadPool& pool);
+    EngineEstimate EstimateEngines(size_t stop_count, size_t ride_count, size_t call_count) const;
+    RoutingEngine ChooseEngine(const EngineEstimate& estimate) const;
+    bool KeepsEdgeGraph(const EngineEstimate& estimate) const;
+    static size_t GetEstimatedBytes(const EngineEstimate& estimate, RoutingEngine engine);
+    void CollapseParallelEdges(std::vector<graph::Edge<double, RouteIndex>>& edges, ThreadPool& pool);
+    // Pairs the component labels prove unreachable, answered without a search.
+    bool IsUnreachable(size_t id_stop_from, size_t id_stop_to) const;
+    // The fastest route alone, for multi-route requests the engine has no edges for.
+    std::vector<RouteStatistic> GetFastestRouteStats(size_t id_stop_from, size_t id_stop_to) const;
+    std::optional<FoundRoute> SearchGraph(const AccessLegs& origins, const AccessLegs& destinations,
+                                          const Disruption& disruption, const RoutingSettings& settings) const;
+    std::optional<FoundRoute> SearchImplicit(const AccessLegs& origins, const AccessLegs& destinations,
+                                             const Disruption& disruption, const RoutingSettings& settings) const;
+    bool HasBaseWeights(const RoutingSettings& settings) const;
+    double GetEdgeWeight(graph::EdgeId edge_id, const RoutingSettings& settings) const;
+    double GetRideWeight(const EdgeAditionInfo& ride, const RoutingSettings& settings) const;
+    double GetRideTime(double distance, const RoutingSettings& settings) const;
+    AccessLegs GetAccessLegs(const RoutePoint& point, const RoutingSettings& settings) const;
+    static Terminals GetTerminals(const AccessLegs& legs);
+    graph::ShortestPathSearch<double, RouteIndex>::Heuristic MakeHeuristic(const AccessLegs& destinations, const RoutingSettings& settings) const;
+    double GetWalkingTime(double distance, const RoutingSettings& settings) const;
+    void AddRideItems(const std::vector<graph::EdgeId>& edges, std::vector<RouteStatistic::VariantItem>& items) const;
+    void AddRideItems(const std::vector<graph::EdgeId>& edges, std::vector<RouteStatistic::VariantItem>& items, const RoutingSettings& settings,
+                      const RideSubstitutes& substitutes = {}) const;
+
+    const TransportCatalogue* catalogue_ = nullptr;
     std::vector<EdgeAditionInfo> edges_buses_;
+    // The rides an edge replaced, shortest first: those of edge e are
+    // edge_alternatives_[edge_alternative_offsets_[e] .. edge_alternative_offsets_[e + 1]).
+    std::vector<size_t> edge_alternative_offsets_;
+    std::vector<EdgeAditionInfo> edge_alternatives_;
+    std::unordered_map<std::string_view, size_t> bus_indices_;
+    // Edges whose ride is on bus b: bus_edge_ids_[bus_edge_offsets_[b] .. bus_edge_offsets_[b + 1]).
+    std::vector<size_t> bus_edge_offsets_;
+    std::vector<graph::EdgeId> bus_edge_ids_;
+    StopCalls stop_calls_;
     std::vector<std::string_view> id_for_stops;
-    std::optional<graph::DirectedWeightedGraph<double>> opt_graph_;
-    std::unique_ptr<graph::Router<double>> up_router_;
+    // Lower bound on road metres per metre of great-circle distance.
+    double min_detour_ = 0;
+    std::optional<graph::DirectedWeightedGraph<double, RouteIndex>> opt_graph_;
+    std::unique_ptr<graph::Router<double, RouteIndex>> up_router_;
+    RoutingEngine engine_ = RoutingEngine::ALL_PAIRS;
+    Timetable timetable_;
+    mutable std::mutex build_mutex_;
+    // Declared last, so that a pending build ends before the members it fills are destroyed.
+    std::shared_future<void> build_;
 };
 
 } //namespace transport_catalogue 